@@ -0,0 +1,77 @@
+/*
+ * Designed and developed by 2022 skydoves (Jaewoong Eum)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.skydoves.cloudy.benchmark
+
+import androidx.benchmark.macro.BaselineProfileMode
+import androidx.benchmark.macro.CompilationMode
+import androidx.benchmark.macro.ExperimentalMetricApi
+import androidx.benchmark.macro.FrameTimingMetric
+import androidx.benchmark.macro.StartupMode
+import androidx.benchmark.macro.TraceSectionMetric
+import androidx.benchmark.macro.junit4.MacrobenchmarkRule
+import androidx.test.internal.runner.junit4.AndroidJUnit4ClassRunner
+import androidx.test.uiautomator.By
+import androidx.test.uiautomator.Direction
+import org.junit.Rule
+import org.junit.Test
+import org.junit.runner.RunWith
+
+/**
+ * Run this benchmark from Studio to see the frame timings of the main screen while its
+ * Cloudy radius animates and while its blurred content is scrolled.
+ *
+ * Besides the frame durations, this measures the [blurTraceSection] around the native blur, so
+ * that the jank caused by the blur can be told from the rest of the frame.
+ */
+@RunWith(AndroidJUnit4ClassRunner::class)
+class BlurFrameTimingBenchmark {
+  @get:Rule
+  val benchmarkRule = MacrobenchmarkRule()
+
+  @Test
+  fun blurNoCompilation() = blur(CompilationMode.None())
+
+  @Test
+  fun blurBaselineProfile() =
+    blur(CompilationMode.Partial(baselineProfileMode = BaselineProfileMode.Require))
+
+  @Test
+  fun blurFullCompilation() = blur(CompilationMode.Full())
+
+  @OptIn(ExperimentalMetricApi::class)
+  private fun blur(compilationMode: CompilationMode) = benchmarkRule.measureRepeated(
+    packageName = targetPackage,
+    metrics = listOf(FrameTimingMetric(), TraceSectionMetric(blurTraceSection)),
+    compilationMode = compilationMode,
+    iterations = 10,
+    startupMode = StartupMode.WARM,
+    setupBlock = {
+      pressHome()
+    }
+  ) {
+    // The radius animates from 0 to 15 after the first frames, reblurring on each step.
+    startActivityAndWait()
+    Thread.sleep(radiusAnimationMillis)
+
+    val content = device.findObject(By.res("main"))
+    // Keeps the gestures away from the system navigation.
+    content.setGestureMargin(device.displayWidth / 5)
+    content.fling(Direction.DOWN)
+    device.waitForIdle()
+    content.fling(Direction.UP)
+    device.waitForIdle()
+  }
+}
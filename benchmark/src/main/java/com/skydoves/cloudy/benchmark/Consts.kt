@@ -16,3 +16,9 @@
 package com.skydoves.cloudy.benchmark
 
 internal const val targetPackage = "com.skydoves.cloudydemo"
+
+/** The trace section Cloudy wraps around each blur. */
+internal const val blurTraceSection = "Cloudy#blur"
+
+/** How long the radius animation of the main screen takes, with its delay. */
+internal const val radiusAnimationMillis = 1500L
@@ -34,6 +34,7 @@ android {
   defaultConfig {
     minSdk = Configuration.minSdk
     targetSdk = Configuration.targetSdk
+    buildConfigField("String", "VERSION_NAME", "\"${Configuration.versionName}\"")
     externalNativeBuild {
       cmake {
         cppFlags += "-std=c++17"
@@ -16,7 +16,10 @@
 
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 
+#include "BlurBudget.h"
+#include "Metrics.h"
 #include "RenderScriptToolkit.h"
 #include "TaskProcessor.h"
 #include "Utils.h"
@@ -35,6 +38,11 @@ class BlurTask : public Task {
     const uchar* mIn;
     // Where we store the blurred image.
     uchar* outArray;
+    // When blurring planes rather than interleaved cells, the input and output planes. Each
+    // plane is sizeX * sizeY bytes. mPlaneCount is 0 when we're not blurring planes.
+    const uchar* const* mInPlanes = nullptr;
+    uchar* const* mOutPlanes = nullptr;
+    size_t mPlaneCount = 0;
     // The size of the kernel radius is limited to 25 in ScriptIntrinsicBlur.java.
     // So, the max kernel size is 51 (= 2 * 25 + 1).
     // Considering SSSE3 case, which requires the size is multiple of 4,
@@ -52,10 +60,43 @@ class BlurTask : public Task {
     // The radius of the blur, in floating point and integer format.
     float mRadius;
     int mIradius;
+    // How the RGB channels of uchar4 cells relate to the alpha channel.
+    AlphaMode mAlphaMode = AlphaMode::Premultiplied;
+    // The space in which the RGB channels of uchar4 cells are blurred.
+    BlurSpace mBlurSpace = BlurSpace::Encoded;
+    // If not null, the shape the output is clipped to.
+    const ClipShape* mClip = nullptr;
+    // Whether uchar4 cells are deinterleaved into planes and blurred with the U_8 kernels.
+    bool mRgbaAsPlanes = false;
+    // Whether unpremultiplied uchar4 cells were premultiplied in mIn already, so that only the
+    // store unpremultiplies them.
+    bool mInputPremultiplied = false;
+    // The number of rows each kernel path processed, one entry per thread. They are added to
+    // the MetricsRegistry once the task is done, so that threads don't contend on the counters.
+    struct alignas(64) KernelRows {
+        uint64_t rows[kKernelPathCount] = {};
+    };
+    std::vector<KernelRows> mKernelRows;
 
-    void kernelU4(void* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY,
+    // The kernels return the path they took, see KernelPath.
+    KernelPath kernelU4(void* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY,
+                        uint32_t threadIndex);
+    template <typename Conversion>
+    void kernelU4Converted(void* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY,
+                           uint32_t threadIndex, const Conversion& conversion);
+    void kernelU3(void* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY,
                   uint32_t threadIndex);
-    void kernelU1(void* outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY);
+    KernelPath kernelU1(void* outPtr, const uchar* in, uint32_t stride, uint32_t firstRow,
+                        uint32_t xstart, uint32_t xend, uint32_t currentY);
+    void processPlanes(int threadIndex, size_t startX, size_t startY, size_t endX, size_t endY);
+    void processRgbaAsPlanes(int threadIndex, size_t startX, size_t startY, size_t endX,
+                             size_t endY);
+    // Returns the scratch area of the thread, grown to at least size bytes and aligned to 16.
+    void* scratchArea(int threadIndex, size_t size);
+    // Returns true if all the cells the blur of the tile reads are equal.
+    bool isUniformNeighborhood(size_t startX, size_t startY, size_t endX, size_t endY) const;
+    // Blurs the cells from startX to endX, excluded, of row y, as specified by our modes.
+    void kernelRow(size_t startX, size_t endX, size_t y, int threadIndex);
     void ComputeGaussianWeights();
 
     // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
@@ -64,25 +105,72 @@ class BlurTask : public Task {
 
    public:
     BlurTask(const uint8_t* in, uint8_t* out, size_t sizeX, size_t sizeY, size_t vectorSize,
-             uint32_t threadCount, float radius, const Restriction* restriction)
-        : Task{sizeX, sizeY, vectorSize, false, restriction},
+             uint32_t threadCount, float radius, const Restriction* restriction,
+             AlphaMode alphaMode = AlphaMode::Premultiplied,
+             BlurSpace blurSpace = BlurSpace::Encoded, size_t restrictionCount = 1)
+        : Task{sizeX, sizeY, vectorSize, false, restriction, restrictionCount},
           mIn{in},
           outArray{out},
           mScratch{threadCount},
           mScratchSize{threadCount},
-          mRadius{std::min(25.0f, radius)} {
+          mRadius{std::min(25.0f, radius)},
+          mAlphaMode{alphaMode},
+          mBlurSpace{blurSpace},
+          mKernelRows{threadCount} {
         ComputeGaussianWeights();
     }
 
+    /**
+     * Blurs planeCount planes of sizeX * sizeY bytes each from inPlanes into outPlanes.
+     */
+    BlurTask(const uint8_t* const* inPlanes, uint8_t* const* outPlanes, size_t planeCount,
+             size_t sizeX, size_t sizeY, uint32_t threadCount, float radius,
+             const Restriction* restriction)
+        : Task{sizeX, sizeY, planeCount, false, restriction},
+          mIn{nullptr},
+          outArray{nullptr},
+          mInPlanes{inPlanes},
+          mOutPlanes{outPlanes},
+          mPlaneCount{planeCount},
+          mScratch{threadCount},
+          mScratchSize{threadCount},
+          mRadius{std::min(25.0f, radius)},
+          mKernelRows{threadCount} {
+        ComputeGaussianWeights();
+    }
+
+    // The clip should outlive this instance.
+    void setClip(const ClipShape* clip) { mClip = clip; }
+    // Blur uchar4 cells as four planes. See processRgbaAsPlanes().
+    void setRgbaAsPlanes(bool rgbaAsPlanes) { mRgbaAsPlanes = rgbaAsPlanes; }
+    // The input of an AlphaMode::Unpremultiplied, BlurSpace::Encoded blur is premultiplied.
+    void setInputPremultiplied(bool premultiplied) { mInputPremultiplied = premultiplied; }
+
     ~BlurTask() {
         for (size_t i = 0; i < mScratch.size(); i++) {
             if (mScratch[i]) {
                 free(mScratch[i]);
             }
         }
+        uint64_t rows[kKernelPathCount] = {};
+        for (const KernelRows& threadRows : mKernelRows) {
+            for (size_t p = 0; p < kKernelPathCount; p++) {
+                rows[p] += threadRows.rows[p];
+            }
+        }
+        MetricsRegistry::get().recordKernelRows(rows);
     }
 };
 
+void* BlurTask::scratchArea(int threadIndex, size_t size) {
+    if (size > mScratchSize[threadIndex] || !mScratch[threadIndex]) {
+        // Pad the allocation to allow alignment, as realloc only aligns to 8 bytes.
+        mScratch[threadIndex] = realloc(mScratch[threadIndex], size + 15);
+        mScratchSize[threadIndex] = size;
+    }
+    return (void*)((((intptr_t)mScratch[threadIndex]) + 15) & ~0xf);
+}
+
 void BlurTask::ComputeGaussianWeights() {
     memset(mFp, 0, sizeof(mFp));
     memset(mIp, 0, sizeof(mIp));
@@ -125,6 +213,37 @@ void BlurTask::ComputeGaussianWeights() {
     }
 }
 
+/**
+ * Returns a table of a / 255 for each alpha value a. Multiplying a straight alpha color by the
+ * entry for its alpha premultiplies it.
+ */
+static const float* premultiplyTable() {
+    static const struct Table {
+        float values[256];
+        Table() {
+            for (int a = 0; a < 256; a++) {
+                values[a] = a / 255.0f;
+            }
+        }
+    } table;
+    return table.values;
+}
+
+/**
+ * Loads a uchar4 cell as floats, premultiplying it if premultiply is not null.
+ *
+ * @param cell The cell to load.
+ * @param premultiply Null if the cell is premultiplied already, premultiplyTable() otherwise.
+ */
+static inline float4 loadU4(uchar4 cell, const float* premultiply) {
+    float4 f = convert<float4>(cell);
+    if (premultiply != nullptr) {
+        f *= premultiply[cell.w];
+        f.w = cell.w;
+    }
+    return f;
+}
+
 /**
  * Vertical blur of a uchar4 line.
  *
@@ -136,9 +255,10 @@ void BlurTask::ComputeGaussianWeights() {
  * @param iStride The size in byte of a row of the input array.
  * @param gPtr The gaussian coefficients.
  * @param iradius The radius of the blur.
+ * @param premultiply If not null, the premultiplyTable() to premultiply the cells with.
  */
 static void OneVU4(uint32_t sizeY, float4* out, int32_t x, int32_t y, const uchar* ptrIn,
-                   int iStride, const float* gPtr, int iradius) {
+                   int iStride, const float* gPtr, int iradius, const float* premultiply) {
     const uchar *pi = ptrIn + x*4;
 
     float4 blurredPixel = 0;
@@ -146,7 +266,7 @@ static void OneVU4(uint32_t sizeY, float4* out, int32_t x, int32_t y, const ucha
         int validY = std::max((y + r), 0);
         validY = std::min(validY, (int)(sizeY - 1));
         const uchar4 *pvy = (const uchar4 *)&pi[validY * iStride];
-        float4 pf = convert<float4>(pvy[0]);
+        float4 pf = loadU4(pvy[0], premultiply);
         blurredPixel += pf * gPtr[0];
         gPtr++;
     }
@@ -161,13 +281,15 @@ static void OneVU4(uint32_t sizeY, float4* out, int32_t x, int32_t y, const ucha
  * @param out Where to place the computed value.
  * @param x Coordinate of the point we're blurring.
  * @param y Coordinate of the point we're blurring.
- * @param ptrIn Start of the input array.
+ * @param ptrIn Start of the input array, i.e. of its row firstRow.
  * @param iStride The size in byte of a row of the input array.
  * @param gPtr The gaussian coefficients.
  * @param iradius The radius of the blur.
+ * @param firstRow The first row held by ptrIn, when it only holds the rows that are read.
  */
 static void OneVU1(uint32_t sizeY, float *out, int32_t x, int32_t y,
-                   const uchar *ptrIn, int iStride, const float* gPtr, int iradius) {
+                   const uchar *ptrIn, int iStride, const float* gPtr, int iradius,
+                   int32_t firstRow = 0) {
 
     const uchar *pi = ptrIn + x;
 
@@ -175,7 +297,7 @@ static void OneVU1(uint32_t sizeY, float *out, int32_t x, int32_t y,
     for (int r = -iradius; r <= iradius; r ++) {
         int validY = std::max((y + r), 0);
         validY = std::min(validY, (int)(sizeY - 1));
-        float pf = (float)pi[validY * iStride];
+        float pf = (float)pi[(validY - firstRow) * iStride];
         blurredPixel += pf * gPtr[0];
         gPtr++;
     }
@@ -209,12 +331,14 @@ extern void rsdIntrinsicBlurHFU1_K(void *dst, const void *pin, const void *gptr,
  * @param ct The diameter of the blur.
  * @param len How many cells to blur.
  * @param usesSimd Whether this processor supports SIMD.
+ * @param premultiply If not null, the premultiplyTable() to premultiply the cells with. The
+ *        SSSE3 kernel can't, so the float4 loop below does the whole line then.
  */
 static void OneVFU4(float4 *out, const uchar *ptrIn, int iStride, const float* gPtr, int ct,
-                    int x2, bool usesSimd) {
+                    int x2, bool usesSimd, const float* premultiply) {
     int x1 = 0;
 #if defined(ARCH_X86_HAVE_SSSE3)
-    if (usesSimd) {
+    if (usesSimd && premultiply == nullptr) {
         int t = (x2 - x1);
         t &= ~1;
         if (t) {
@@ -233,7 +357,7 @@ static void OneVFU4(float4 *out, const uchar *ptrIn, int iStride, const float* g
         const float* gp = gPtr;
 
         for (int r = 0; r < ct; r++) {
-            float4 pf = convert<float4>(((const uchar4 *)pi)[0]);
+            float4 pf = loadU4(((const uchar4 *)pi)[0], premultiply);
             blurredPixel += pf * gp[0];
             pi += iStride;
             gp++;
@@ -358,17 +482,88 @@ static void OneHU1(uint32_t sizeX, uchar* out, int32_t x, const float* ptrIn, co
     out[0] = (uchar)blurredPixel;
 }
 
+/**
+ * Horizontal blur of a packed uchar3 line.
+ *
+ * The vertical pass leaves the line as 3 * sizeX floats, in the same packed layout as the input.
+ *
+ * @param sizeX Number of cells of the input array in the horizontal direction.
+ * @param out Where to place the computed value.
+ * @param x Coordinate of the point we're blurring.
+ * @param ptrIn The start of the input row from which we're indexing x.
+ * @param gPtr The gaussian coefficients.
+ * @param iradius The radius of the blur.
+ */
+static void OneHU3(uint32_t sizeX, uchar* out, int32_t x, const float* ptrIn, const float* gPtr,
+                   int iradius) {
+    float3 blurredPixel = 0;
+    for (int r = -iradius; r <= iradius; r ++) {
+        int validX = std::max((x + r), 0);
+        validX = std::min(validX, (int)(sizeX - 1));
+        const float* pf = ptrIn + validX * 3;
+        blurredPixel += float3{pf[0], pf[1], pf[2]} * gPtr[0];
+        gPtr++;
+    }
+
+    out[0] = (uchar)blurredPixel.x;
+    out[1] = (uchar)blurredPixel.y;
+    out[2] = (uchar)blurredPixel.z;
+}
+
+/**
+ * Horizontal blur of a packed uchar3 line, knowing that there's enough cells to the left and
+ * right of us to avoid dealing with boundary conditions.
+ *
+ * Because the three channels stay packed, each channel's neighbor is exactly three floats
+ * away. We can then treat the line as a flat array of floats and convolve it with a stride of
+ * three, four lanes at a time, without ever deinterleaving the channels.
+ *
+ * @param out Where to store the results.
+ * @param ptrIn The input data, starting at the leftmost value used by the first output.
+ * @param gPtr The gaussian coefficients.
+ * @param ct The diameter of the blur.
+ * @param len How many bytes, i.e. 3 times the number of cells, to blur.
+ */
+static void OneHFU3(uchar* out, const float* ptrIn, const float* gPtr, int ct, int len) {
+    // The values we load are only guaranteed to be aligned on a float.
+    typedef float float4u __attribute__((ext_vector_type(4), aligned(4)));
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        const float* pi = ptrIn + i;
+        float4 blurredPixel = 0;
+        for (int r = 0; r < ct; r++) {
+            blurredPixel += *(const float4u*)pi * gPtr[r];
+            pi += 3;
+        }
+        uchar4 packed = convert<uchar4>(blurredPixel);
+        memcpy(out + i, &packed, sizeof(packed));
+    }
+    for (; i < len; i++) {
+        const float* pi = ptrIn + i;
+        float blurredPixel = 0;
+        for (int r = 0; r < ct; r++) {
+            blurredPixel += pi[0] * gPtr[r];
+            pi += 3;
+        }
+        out[i] = (uchar)blurredPixel;
+    }
+}
+
 /**
  * Full blur of a line of RGBA data.
  *
+ * Unpremultiplied cells are premultiplied in float as the vertical pass loads them, so the
+ * assembly kernel, which reads the bytes as is, is skipped for them. The caller unpremultiplies
+ * the stored row.
+ *
  * @param outPtr Where to store the results
  * @param xstart The index of the section we're starting to blur.
  * @param xend  The end index of the section.
  * @param currentY The index of the line we're blurring.
  * @param usesSimd Whether this processor supports SIMD.
  */
-void BlurTask::kernelU4(void *outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY,
-                        uint32_t threadIndex) {
+KernelPath BlurTask::kernelU4(void *outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY,
+                              uint32_t threadIndex) {
     float4 stackbuf[2048];
     float4 *buf = &stackbuf[0];
     const uint32_t stride = mSizeX * mVectorSize;
@@ -377,33 +572,35 @@ void BlurTask::kernelU4(void *outPtr, uint32_t xstart, uint32_t xend, uint32_t c
     uint32_t x1 = xstart;
     uint32_t x2 = xend;
 
+    const float* premultiply = mAlphaMode == AlphaMode::Unpremultiplied && !mInputPremultiplied
+                                       ? premultiplyTable()
+                                       : nullptr;
+
 #if defined(ARCH_ARM_USE_INTRINSICS)
-    if (mUsesSimd && mSizeX >= 4) {
+    if (mUsesSimd && mSizeX >= 4 && premultiply == nullptr) {
       rsdIntrinsicBlurU4_K(out, (uchar4 const *)(mIn + stride * currentY),
                  mSizeX, mSizeY,
                  stride, x1, currentY, x2 - x1, mIradius, mIp + mIradius);
-        return;
+        return KernelPath::U4Asm;
     }
 #endif
 
+    KernelPath path = premultiply != nullptr ? KernelPath::U4Converted
+                      : mUsesSimd                ? KernelPath::U4Float
+                                                 : KernelPath::U4Scalar;
     if (mSizeX > 2048) {
-        if ((mSizeX > mScratchSize[threadIndex]) || !mScratch[threadIndex]) {
-            // Pad the side of the allocation by one unit to allow alignment later
-            mScratch[threadIndex] = realloc(mScratch[threadIndex], (mSizeX + 1) * 16);
-            mScratchSize[threadIndex] = mSizeX;
-        }
-        // realloc only aligns to 8 bytes so we manually align to 16.
-        buf = (float4 *) ((((intptr_t)mScratch[threadIndex]) + 15) & ~0xf);
+        buf = (float4 *)scratchArea(threadIndex, mSizeX * sizeof(float4));
     }
     float4 *fout = (float4 *)buf;
     int y = currentY;
     if ((y > mIradius) && (y < ((int)mSizeY - mIradius))) {
         const uchar *pi = mIn + (y - mIradius) * stride;
-        OneVFU4(fout, pi, stride, mFp, mIradius * 2 + 1, mSizeX, mUsesSimd);
+        OneVFU4(fout, pi, stride, mFp, mIradius * 2 + 1, mSizeX, mUsesSimd, premultiply);
     } else {
+        path = KernelPath::U4EdgeRow;
         x1 = 0;
         while(mSizeX > x1) {
-            OneVU4(mSizeY, fout, x1, y, mIn, stride, mFp, mIradius);
+            OneVU4(mSizeY, fout, x1, y, mIn, stride, mFp, mIradius, premultiply);
             fout++;
             x1++;
         }
@@ -430,19 +627,309 @@ void BlurTask::kernelU4(void *outPtr, uint32_t xstart, uint32_t xend, uint32_t c
         out++;
         x1++;
     }
+    return path;
+}
+
+/**
+ * Returns a table of 255 / a for each alpha value a, with 0 for a == 0. Multiplying a
+ * premultiplied color by the entry for its alpha unpremultiplies it.
+ */
+static const float* unpremultiplyTable() {
+    static const struct Table {
+        float values[256];
+        Table() {
+            values[0] = 0.0f;
+            for (int a = 1; a < 256; a++) {
+                values[a] = 255.0f / a;
+            }
+        }
+    } table;
+    return table.values;
+}
+
+/**
+ * Converts a row of blurred premultiplied cells back to straight alpha, in place. The colors are
+ * rounded to the nearest value and clamped, as rounding errors of the blur can push a color
+ * slightly past its alpha.
+ */
+static void unpremultiplyRow(uchar4* cells, size_t count) {
+    const float* unpremultiply = unpremultiplyTable();
+    for (size_t x = 0; x < count; x++) {
+        const uchar4 cell = cells[x];
+        float4 f = convert<float4>(cell) * unpremultiply[cell.w] + 0.5f;
+        f.w = cell.w;
+        cells[x] = convert<uchar4>(clamp(f, 0.0f, 255.0f));
+    }
+}
+
+/**
+ * Tables to convert between sRGB encoded values and linear light.
+ *
+ * Decoding is a lookup of the 256 possible encoded values. The linear values are scaled to
+ * [0, kLinearMax] so that, once blurred, they can directly index the encoding table. That
+ * table has 4096 entries, which is enough to get each encoded value back, is small enough to
+ * stay in the L1 cache, and needs no math beyond a round to be indexed.
+ */
+struct SrgbTables {
+    static constexpr int kLinearMax = 4095;
+    float decode[256];
+    uchar encode[kLinearMax + 1];
+
+    SrgbTables() {
+        for (int i = 0; i < 256; i++) {
+            const float c = i / 255.0f;
+            const float linear = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+            decode[i] = linear * kLinearMax;
+        }
+        for (int i = 0; i <= kLinearMax; i++) {
+            const float linear = (float)i / kLinearMax;
+            const float c = linear <= 0.0031308f ? linear * 12.92f
+                                                 : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+            encode[i] = (uchar)(clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+    }
+
+    static const SrgbTables& get() {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    float3 toLinear(uchar4 in) const {
+        return float3{decode[in.x], decode[in.y], decode[in.z]};
+    }
+
+    uchar3 toEncoded(float3 in) const {
+        const int3 index = convert<int3>(clampChannels(in, 0.0f, (float)kLinearMax) + 0.5f);
+        return uchar3{encode[index.x], encode[index.y], encode[index.z]};
+    }
+
+    static float3 clampChannels(float3 v, float low, float high) {
+        return float3{clamp(v.x, low, high), clamp(v.y, low, high), clamp(v.z, low, high)};
+    }
+};
+
+/**
+ * Blurs unpremultiplied sRGB cells in linear light. The cells are decoded and premultiplied as
+ * they are loaded, and unpremultiplied and encoded as they are stored.
+ */
+struct SrgbUnpremultipliedConversion {
+    const SrgbTables& srgb = SrgbTables::get();
+    const float* unpremultiply = unpremultiplyTable();
+
+    float4 load(uchar4 in) const {
+        const float alpha = in.w;
+        float4 f;
+        f.xyz = srgb.toLinear(in) * (alpha * (1.0f / 255.0f));
+        f.w = alpha;
+        return f;
+    }
+
+    uchar4 store(float4 in) const {
+        const uchar alpha = (uchar)(clamp(in.w, 0.0f, 255.0f) + 0.5f);
+        uchar4 out;
+        out.xyz = srgb.toEncoded(in.xyz * unpremultiply[alpha]);
+        out.w = alpha;
+        return out;
+    }
+};
+
+/**
+ * Blurs premultiplied sRGB cells in linear light. Premultiplied cells were multiplied by alpha
+ * after being encoded, so they're unpremultiplied before being decoded, then premultiplied
+ * again in linear light. The opposite is done when storing.
+ */
+struct SrgbPremultipliedConversion {
+    const SrgbTables& srgb = SrgbTables::get();
+    const float* unpremultiply = unpremultiplyTable();
+
+    float4 load(uchar4 in) const {
+        const float alpha = in.w;
+        const float4 straight = convert<float4>(in) * unpremultiply[in.w] + 0.5f;
+        const uchar4 encoded = convert<uchar4>(clamp(straight, 0.0f, 255.0f));
+        float4 f;
+        f.xyz = srgb.toLinear(encoded) * (alpha * (1.0f / 255.0f));
+        f.w = alpha;
+        return f;
+    }
+
+    uchar4 store(float4 in) const {
+        const uchar alpha = (uchar)(clamp(in.w, 0.0f, 255.0f) + 0.5f);
+        const float3 encoded = convert<float3>(srgb.toEncoded(in.xyz * unpremultiply[alpha]));
+        uchar4 out;
+        out.xyz = convert<uchar3>(encoded * (alpha * (1.0f / 255.0f)) + 0.5f);
+        out.w = alpha;
+        return out;
+    }
+};
+
+/**
+ * Vertical blur of a uchar4 line, converting each cell as it is loaded.
+ *
+ * The rows are visited one at a time, so the edge rows are handled by clamping the row index
+ * once per row rather than once per cell.
+ *
+ * @param sizeY Number of cells of the input array in the vertical direction.
+ * @param out Where to store the results. This is the input to the horizontal blur.
+ * @param sizeX Number of cells of the line.
+ * @param y The index of the line we're blurring.
+ * @param ptrIn Start of the input array.
+ * @param iStride The size in byte of a row of the input array.
+ * @param gPtr The gaussian coefficients.
+ * @param iradius The radius of the blur.
+ * @param conversion Converts the cells as they're loaded.
+ */
+template <typename Conversion>
+static void OneVU4Converted(uint32_t sizeY, float4* out, uint32_t sizeX, int32_t y,
+                            const uchar* ptrIn, int iStride, const float* gPtr, int iradius,
+                            const Conversion& conversion) {
+    for (uint32_t x = 0; x < sizeX; x++) {
+        out[x] = 0;
+    }
+    for (int r = -iradius; r <= iradius; r ++) {
+        int validY = std::max((y + r), 0);
+        validY = std::min(validY, (int)(sizeY - 1));
+        const uchar4* pvy = (const uchar4*)&ptrIn[validY * iStride];
+        const float g = gPtr[0];
+        for (uint32_t x = 0; x < sizeX; x++) {
+            out[x] += conversion.load(pvy[x]) * g;
+        }
+        gPtr++;
+    }
+}
+
+/**
+ * Horizontal blur of a uchar4 line, converting each cell as it is stored.
+ *
+ * @param sizeX Number of cells of the input array in the horizontal direction.
+ * @param out Where to place the computed value.
+ * @param x Coordinate of the point we're blurring.
+ * @param ptrIn The start of the input row from which we're indexing x.
+ * @param gPtr The gaussian coefficients.
+ * @param iradius The radius of the blur.
+ * @param conversion Converts the cells as they're stored.
+ */
+template <typename Conversion>
+static void OneHU4Converted(uint32_t sizeX, uchar4* out, int32_t x, const float4* ptrIn,
+                            const float* gPtr, int iradius, const Conversion& conversion) {
+    float4 blurredPixel = 0;
+    if (x >= iradius && x + iradius < (int32_t)sizeX) {
+        const float4* pi = ptrIn + x - iradius;
+        for (int r = 0; r <= 2 * iradius; r++) {
+            blurredPixel += pi[r] * gPtr[r];
+        }
+    } else {
+        for (int r = -iradius; r <= iradius; r ++) {
+            int validX = std::max((x + r), 0);
+            validX = std::min(validX, (int)(sizeX - 1));
+            blurredPixel += ptrIn[validX] * gPtr[0];
+            gPtr++;
+        }
+    }
+
+    out[0] = conversion.store(blurredPixel);
+}
+
+/**
+ * Full blur of a line of RGBA data, converting the cells as they are loaded and stored.
+ *
+ * This is used when the cells are not blurred as is, i.e. when they are blurred in linear
+ * light. Doing the conversions in the blur passes avoids extra passes over the whole image.
+ *
+ * @param outPtr Where to store the results
+ * @param xstart The index of the section we're starting to blur.
+ * @param xend  The end index of the section.
+ * @param currentY The index of the line we're blurring.
+ * @param threadIndex The index of the thread, used to find its scratch area.
+ * @param conversion Converts the cells as they're loaded and stored.
+ */
+template <typename Conversion>
+void BlurTask::kernelU4Converted(void *outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY,
+                                 uint32_t threadIndex, const Conversion& conversion) {
+    float4 stackbuf[2048];
+    float4 *buf = &stackbuf[0];
+    const uint32_t stride = mSizeX * mVectorSize;
+
+    if (mSizeX > 2048) {
+        buf = (float4 *)scratchArea(threadIndex, mSizeX * sizeof(float4));
+    }
+    OneVU4Converted(mSizeY, buf, mSizeX, currentY, mIn, stride, mFp, mIradius, conversion);
+
+    uchar4 *out = (uchar4 *)outPtr;
+    for (uint32_t x = xstart; x < xend; x++) {
+        OneHU4Converted(mSizeX, out, x, buf, mFp, mIradius, conversion);
+        out++;
+    }
+}
+
+/**
+ * Full blur of a line of packed RGB data.
+ *
+ * The three channels are blurred without padding them to four. The vertical pass doesn't
+ * care about cells, so we reuse the U_8 code on the whole 3 * sizeX bytes of the line.
+ *
+ * @param outPtr Where to store the results
+ * @param xstart The index of the section we're starting to blur.
+ * @param xend  The end index of the section.
+ * @param currentY The index of the line we're blurring.
+ * @param threadIndex The index of the thread, used to find its scratch area.
+ */
+void BlurTask::kernelU3(void *outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY,
+                        uint32_t threadIndex) {
+    float stackbuf[3 * 2048];
+    float *buf = &stackbuf[0];
+    const uint32_t stride = mSizeX * mVectorSize;
+
+    uchar *out = (uchar *)outPtr;
+    uint32_t x1 = xstart;
+    uint32_t x2 = xend;
+
+    if (mSizeX > 2048) {
+        buf = (float *)scratchArea(threadIndex, stride * sizeof(float));
+    }
+    int y = currentY;
+    if ((y > mIradius) && (y < ((int)mSizeY - mIradius - 1))) {
+        const uchar *pi = mIn + (y - mIradius) * stride;
+        OneVFU1(buf, pi, stride, mFp, mIradius * 2 + 1, stride, mUsesSimd);
+    } else {
+        for (uint32_t i = 0; i < stride; i++) {
+            OneVU1(mSizeY, buf + i, i, y, mIn, stride, mFp, mIradius);
+        }
+    }
+
+    while ((x1 < (uint32_t)mIradius) && (x1 < x2)) {
+        OneHU3(mSizeX, out, x1, buf, mFp, mIradius);
+        out += 3;
+        x1++;
+    }
+    const int interiorEnd = std::min((int)x2, (int)mSizeX - mIradius);
+    if ((int)x1 < interiorEnd) {
+        uint32_t len = interiorEnd - x1;
+        OneHFU3(out, buf + (x1 - mIradius) * 3, mFp, mIradius * 2 + 1, len * 3);
+        out += len * 3;
+        x1 += len;
+    }
+    while (x2 > x1) {
+        OneHU3(mSizeX, out, x1, buf, mFp, mIradius);
+        out += 3;
+        x1++;
+    }
 }
 
 /**
  * Full blur of a line of U_8 data.
  *
  * @param outPtr Where to store the results
+ * @param in The plane we're blurring, starting at its row firstRow. It must hold the rows
+ *        within the radius of currentY.
+ * @param stride The size in bytes of a row of the plane, at least sizeX.
+ * @param firstRow The first row held by in, 0 for a whole plane.
  * @param xstart The index of the section we're starting to blur.
  * @param xend  The end index of the section.
  * @param currentY The index of the line we're blurring.
  */
-void BlurTask::kernelU1(void *outPtr, uint32_t xstart, uint32_t xend, uint32_t currentY) {
+KernelPath BlurTask::kernelU1(void *outPtr, const uchar *in, uint32_t stride, uint32_t firstRow,
+                              uint32_t xstart, uint32_t xend, uint32_t currentY) {
     float buf[4 * 2048];
-    const uint32_t stride = mSizeX * mVectorSize;
 
     uchar *out = (uchar *)outPtr;
     uint32_t x1 = xstart;
@@ -454,22 +941,24 @@ void BlurTask::kernelU1(void *outPtr, uint32_t xstart, uint32_t xend, uint32_t c
         // fiddly to resolve, where starting close to the right edge can cause
         // a read beyond the end of input.  So avoid that case here.
         if (mIradius > 8 || (mSizeX - std::max(0, (int32_t)x1 - 8)) >= 16) {
-            rsdIntrinsicBlurU1_K(out, mIn + stride * currentY, mSizeX, mSizeY,
+            rsdIntrinsicBlurU1_K(out, in + stride * (currentY - firstRow), mSizeX, mSizeY,
                      stride, x1, currentY, x2 - x1, mIradius, mIp + mIradius);
-            return;
+            return KernelPath::U1Asm;
         }
     }
 #endif
 
+    KernelPath path = mUsesSimd ? KernelPath::U1Float : KernelPath::U1Scalar;
     float *fout = (float *)buf;
     int y = currentY;
     if ((y > mIradius) && (y < ((int)mSizeY - mIradius -1))) {
-        const uchar *pi = mIn + (y - mIradius) * stride;
+        const uchar *pi = in + (y - mIradius - firstRow) * stride;
         OneVFU1(fout, pi, stride, mFp, mIradius * 2 + 1, mSizeX, mUsesSimd);
     } else {
+        path = KernelPath::U1EdgeRow;
         x1 = 0;
         while(mSizeX > x1) {
-            OneVU1(mSizeY, fout, x1, y, mIn, stride, mFp, mIradius);
+            OneVU1(mSizeY, fout, x1, y, in, stride, mFp, mIradius, firstRow);
             fout++;
             x1++;
         }
@@ -506,22 +995,554 @@ void BlurTask::kernelU1(void *outPtr, uint32_t xstart, uint32_t xend, uint32_t c
         out++;
         x1++;
     }
+    return path;
+}
+
+/**
+ * Signed distance from the center of the cell (x, y) to the edge of the rounded rectangle
+ * of the clip. Negative inside.
+ */
+static float roundedRectDistance(const ClipShape& clip, size_t x, size_t y) {
+    const float halfWidth = (clip.right - clip.left) * 0.5f;
+    const float halfHeight = (clip.bottom - clip.top) * 0.5f;
+    const float radius = std::min(clip.cornerRadius, std::min(halfWidth, halfHeight));
+    const float qx = fabsf(x + 0.5f - (clip.left + halfWidth)) - (halfWidth - radius);
+    const float qy = fabsf(y + 0.5f - (clip.top + halfHeight)) - (halfHeight - radius);
+    const float outside = sqrtf(std::max(qx, 0.0f) * std::max(qx, 0.0f) +
+                                std::max(qy, 0.0f) * std::max(qy, 0.0f));
+    return outside + std::min(std::max(qx, qy), 0.0f) - radius;
+}
+
+/**
+ * Returns how much the clip covers the cell (x, y), from 0 to 255.
+ */
+static uchar clipCoverage(const ClipShape& clip, size_t sizeX, size_t x, size_t y) {
+    if (clip.mask != nullptr) {
+        return clip.mask[sizeX * y + x];
+    }
+    const float coverage = clamp(0.5f - roundedRectDistance(clip, x, y), 0.0f, 1.0f);
+    return (uchar)(coverage * 255.0f + 0.5f);
+}
+
+/**
+ * Narrows [*startX, *endX) to the cells of row y that the clip covers at least partially.
+ * Returns false if the clip does not cover any of them.
+ */
+static bool clipSpan(const ClipShape& clip, size_t sizeX, size_t y, size_t* startX,
+                     size_t* endX) {
+    size_t x1 = *startX;
+    size_t x2 = *endX;
+    if (clip.mask != nullptr) {
+        const uchar* row = clip.mask + sizeX * y;
+        while (x1 < x2 && row[x1] == 0) {
+            x1++;
+        }
+        while (x2 > x1 && row[x2 - 1] == 0) {
+            x2--;
+        }
+    } else {
+        // The cells covered by the rounded rectangle are those less than half a cell outside
+        // of it. Solve for the horizontal extent of that area at the center of the row.
+        const float halfWidth = (clip.right - clip.left) * 0.5f;
+        const float halfHeight = (clip.bottom - clip.top) * 0.5f;
+        const float radius = std::min(clip.cornerRadius, std::min(halfWidth, halfHeight));
+        const float qy = fabsf(y + 0.5f - (clip.top + halfHeight)) - (halfHeight - radius);
+        const float reach = radius + 0.5f;
+        if (qy >= reach) {
+            return false;
+        }
+        const float halfSpan = halfWidth - radius +
+                               (qy > 0.0f ? sqrtf(reach * reach - qy * qy) : reach);
+        const float centerX = clip.left + halfWidth;
+        const float first = floorf(centerX - halfSpan - 0.5f) + 1.0f;
+        const float last = ceilf(centerX + halfSpan - 0.5f);
+        x1 = std::max(x1, (size_t)std::max(first, 0.0f));
+        x2 = std::min(x2, (size_t)std::max(last, 0.0f));
+    }
+    *startX = x1;
+    *endX = x2;
+    return x1 < x2;
+}
+
+/**
+ * Scales the blurred cells of row y by how much the clip covers them. Starting from each end
+ * of the span, we stop as soon as we find a fully covered cell, so only the edges of the
+ * rounded rectangle are visited. Masks can have holes, so all their cells are checked.
+ *
+ * Premultiplied cells are scaled whole. Unpremultiplied cells keep their color and only have
+ * their alpha scaled, otherwise the edges would darken rather than fade out.
+ */
+static void applyClipCoverage(const ClipShape& clip, uchar* out, size_t sizeX, size_t vectorSize,
+                              AlphaMode alphaMode, size_t y, size_t startX, size_t endX) {
+    // vectorSize 1 cells are alpha only, so they are scaled whole in either mode.
+    const size_t firstChannel = alphaMode == AlphaMode::Unpremultiplied ? vectorSize - 1 : 0;
+    auto scale = [&](size_t x, uchar coverage) {
+        uchar* cell = out + (sizeX * y + x) * vectorSize;
+        for (size_t i = firstChannel; i < vectorSize; i++) {
+            cell[i] = (uchar)((cell[i] * coverage + 127) / 255);
+        }
+    };
+    if (clip.mask != nullptr) {
+        for (size_t x = startX; x < endX; x++) {
+            const uchar coverage = clip.mask[sizeX * y + x];
+            if (coverage != 255) {
+                scale(x, coverage);
+            }
+        }
+        return;
+    }
+    size_t left = startX;
+    for (; left < endX; left++) {
+        const uchar coverage = clipCoverage(clip, sizeX, left, y);
+        if (coverage == 255) {
+            break;
+        }
+        scale(left, coverage);
+    }
+    for (size_t right = endX; right > left + 1; right--) {
+        const uchar coverage = clipCoverage(clip, sizeX, right - 1, y);
+        if (coverage == 255) {
+            break;
+        }
+        scale(right - 1, coverage);
+    }
+}
+
+/**
+ * Computes the rows and columns the clip may cover, intersected with the restriction. Returns
+ * false if that area is empty.
+ */
+static bool clipBounds(const ClipShape& clip, size_t sizeX, size_t sizeY,
+                       const Restriction* restriction, Restriction* bounds) {
+    *bounds = restriction != nullptr ? *restriction : Restriction{0, sizeX, 0, sizeY};
+    if (clip.mask == nullptr) {
+        const float left = std::max(floorf(clip.left), 0.0f);
+        const float top = std::max(floorf(clip.top), 0.0f);
+        const float right = std::max(ceilf(clip.right), 0.0f);
+        const float bottom = std::max(ceilf(clip.bottom), 0.0f);
+        bounds->startX = std::max(bounds->startX, (size_t)left);
+        bounds->startY = std::max(bounds->startY, (size_t)top);
+        bounds->endX = std::min(bounds->endX, (size_t)right);
+        bounds->endY = std::min(bounds->endY, (size_t)bottom);
+    }
+    return bounds->startX < bounds->endX && bounds->startY < bounds->endY;
+}
+
+/**
+ * Blurs a tile of each plane with the U_8 kernel.
+ */
+void BlurTask::processPlanes(int threadIndex, size_t startX, size_t startY, size_t endX,
+                             size_t endY) {
+    for (size_t y = startY; y < endY; y++) {
+        for (size_t p = 0; p < mPlaneCount; p++) {
+            const KernelPath path = kernelU1(mOutPlanes[p] + mSizeX * y + startX, mInPlanes[p],
+                                             mSizeX, 0, startX, endX, y);
+            mKernelRows[threadIndex].rows[static_cast<size_t>(path)]++;
+        }
+    }
+}
+
+/**
+ * Blurs a tile of uchar4 cells as four planes with the U_8 kernels, which don't have to shuffle
+ * the channels of each cell.
+ *
+ * The rows the tile reads, i.e. its rows and up to radius rows above and below, are
+ * deinterleaved into the scratch area of the thread. Each row of the tile is then blurred
+ * plane by plane and reinterleaved as it's stored. The rows of the planes are padded to 16
+ * bytes and the kernels see the real coordinates of the rows, so every cell is blurred the
+ * same way whatever the tile it's part of.
+ */
+void BlurTask::processRgbaAsPlanes(int threadIndex, size_t startX, size_t startY, size_t endX,
+                                   size_t endY) {
+    const size_t radius = static_cast<size_t>(mIradius);
+    const size_t firstRow = startY > radius ? startY - radius : 0;
+    const size_t endRow = std::min(endY + radius, mSizeY);
+    const size_t planeStride = (mSizeX + 15) & ~static_cast<size_t>(15);
+    const size_t planeSize = planeStride * (endRow - firstRow);
+    // The four planes, followed by one row of each blurred plane.
+    uchar* planes[4];
+    uchar* blurredRows[4];
+    planes[0] = (uchar*)scratchArea(threadIndex, (planeSize + planeStride) * 4);
+    for (size_t p = 1; p < 4; p++) {
+        planes[p] = planes[p - 1] + planeSize;
+    }
+    for (size_t p = 0; p < 4; p++) {
+        blurredRows[p] = planes[0] + planeSize * 4 + planeStride * p;
+    }
+
+    // The vertical pass of the kernels reads whole rows.
+    for (size_t y = firstRow; y < endRow; y++) {
+        const uchar4* in = (const uchar4*)(mIn + mSizeX * y * 4);
+        const size_t offset = (y - firstRow) * planeStride;
+        for (size_t x = 0; x < mSizeX; x++) {
+            const uchar4 cell = in[x];
+            planes[0][offset + x] = cell.x;
+            planes[1][offset + x] = cell.y;
+            planes[2][offset + x] = cell.z;
+            planes[3][offset + x] = cell.w;
+        }
+    }
+
+    for (size_t y = startY; y < endY; y++) {
+        for (size_t p = 0; p < 4; p++) {
+            const KernelPath path = kernelU1(blurredRows[p] + startX, planes[p], planeStride,
+                                             firstRow, startX, endX, y);
+            mKernelRows[threadIndex].rows[static_cast<size_t>(path)]++;
+        }
+        uchar4* out = (uchar4*)(outArray + mSizeX * y * 4);
+        for (size_t x = startX; x < endX; x++) {
+            out[x] = uchar4{blurredRows[0][x], blurredRows[1][x], blurredRows[2][x],
+                            blurredRows[3][x]};
+        }
+    }
+}
+
+bool BlurTask::isUniformNeighborhood(size_t startX, size_t startY, size_t endX,
+                                     size_t endY) const {
+    // The tile and its radius wide halo. The cells past the edges clamp to cells within it.
+    const size_t radius = static_cast<size_t>(mIradius);
+    const size_t x1 = startX > radius ? startX - radius : 0;
+    const size_t x2 = std::min(endX + radius, mSizeX);
+    const size_t y1 = startY > radius ? startY - radius : 0;
+    const size_t y2 = std::min(endY + radius, mSizeY);
+    const size_t stride = mSizeX * mVectorSize;
+    const size_t spanSize = (x2 - x1) * mVectorSize;
+    const uchar* first = mIn + y1 * stride + x1 * mVectorSize;
+
+    // memcmp is vectorized by libc and returns at the first difference, so the tiles with
+    // content are rejected quickly. The cells of the first row are all equal if the row equals
+    // itself shifted by one cell, and the other rows must equal the first.
+    if (memcmp(first, first + mVectorSize, spanSize - mVectorSize) != 0) {
+        return false;
+    }
+    for (size_t y = y1 + 1; y < y2; y++) {
+        if (memcmp(first, mIn + y * stride + x1 * mVectorSize, spanSize) != 0) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void BlurTask::processData(int threadIndex, size_t startX, size_t startY, size_t endX,
                            size_t endY) {
+    if (mPlaneCount != 0) {
+        processPlanes(threadIndex, startX, startY, endX, endY);
+        return;
+    }
+    // UI captures have large areas of a single color. In a tile whose neighborhood is such an
+    // area, the rows that the kernels blur the same way have the same blur, so we blur one of
+    // them and copy it to the others. Copying what the kernels computed rather than the color
+    // itself keeps the result independent of the tiling. The rows within the radius of the top
+    // and bottom edges take other code paths, and the SIMD code may process a row differently
+    // depending on its alignment, so a row is only copied from one that has the same alignment
+    // and is not near an edge.
+    if (mClip == nullptr && isUniformNeighborhood(startX, startY, endX, endY)) {
+        constexpr size_t kAlignment = 16;
+        const size_t radius = static_cast<size_t>(mIradius);
+        const size_t stride = mSizeX * mVectorSize;
+        const size_t offset = startX * mVectorSize;
+        // The row that was blurred for each alignment, if any.
+        size_t blurredRows[kAlignment];
+        bool hasBlurredRow[kAlignment] = {};
+        for (size_t y = startY; y < endY; y++) {
+            const bool edgeRow = y <= radius || y + radius + 1 >= mSizeY;
+            const size_t alignment = (y * stride) % kAlignment;
+            if (!edgeRow && hasBlurredRow[alignment]) {
+                memcpy(outArray + y * stride + offset,
+                       outArray + blurredRows[alignment] * stride + offset,
+                       (endX - startX) * mVectorSize);
+                mKernelRows[threadIndex].rows[static_cast<size_t>(KernelPath::Uniform)]++;
+                continue;
+            }
+            kernelRow(startX, endX, y, threadIndex);
+            if (!edgeRow) {
+                blurredRows[alignment] = y;
+                hasBlurredRow[alignment] = true;
+            }
+        }
+        return;
+    }
+    if (mRgbaAsPlanes && mClip == nullptr) {
+        processRgbaAsPlanes(threadIndex, startX, startY, endX, endY);
+        return;
+    }
     for (size_t y = startY; y < endY; y++) {
-        void* outPtr = outArray + (mSizeX * y + startX) * mVectorSize;
-        if (mVectorSize == 4) {
-            kernelU4(outPtr, startX, endX, y, threadIndex);
+        if (mClip == nullptr) {
+            kernelRow(startX, endX, y, threadIndex);
+            continue;
+        }
+        // Only blur the span of the row that the clip covers, then fade its edges.
+        size_t x1 = startX;
+        size_t x2 = endX;
+        if (!clipSpan(*mClip, mSizeX, y, &x1, &x2)) {
+            continue;
+        }
+        kernelRow(x1, x2, y, threadIndex);
+        applyClipCoverage(*mClip, outArray, mSizeX, mVectorSize, mAlphaMode, y, x1, x2);
+    }
+}
+
+void BlurTask::kernelRow(size_t startX, size_t endX, size_t y, int threadIndex) {
+    if (mRgbaAsPlanes) {
+        processRgbaAsPlanes(threadIndex, startX, y, endX, y + 1);
+        return;
+    }
+    void* outPtr = outArray + (mSizeX * y + startX) * mVectorSize;
+    KernelPath path;
+    if (mVectorSize == 4) {
+        path = KernelPath::U4Converted;
+        if (mBlurSpace == BlurSpace::Linear) {
+            if (mAlphaMode == AlphaMode::Unpremultiplied) {
+                kernelU4Converted(outPtr, startX, endX, y, threadIndex,
+                                  SrgbUnpremultipliedConversion{});
+            } else {
+                kernelU4Converted(outPtr, startX, endX, y, threadIndex,
+                                  SrgbPremultipliedConversion{});
+            }
         } else {
-            kernelU1(outPtr, startX, endX, y);
+            // Unpremultiplied cells are premultiplied by the vertical pass of kernelU4().
+            path = kernelU4(outPtr, startX, endX, y, threadIndex);
+            if (mAlphaMode == AlphaMode::Unpremultiplied) {
+                unpremultiplyRow((uchar4*)outPtr, endX - startX);
+            }
         }
+    } else if (mVectorSize == 3) {
+        path = KernelPath::U3;
+        kernelU3(outPtr, startX, endX, y, threadIndex);
+    } else {
+        path = kernelU1(outPtr, mIn, mSizeX, 0, startX, endX, y);
     }
+    mKernelRows[threadIndex].rows[static_cast<size_t>(path)]++;
+}
+
+/**
+ * Downscales an image by averaging the area of the input covered by each output cell.
+ *
+ * This is the prefilter of blurAndDownscale(). The scale factors don't need to be integers;
+ * input cells that straddle the edge of an output cell contribute in proportion to the
+ * overlap.
+ */
+class AreaDownscaleTask : public Task {
+    const uchar* mIn;
+    uchar* mOut;
+    const size_t mInputSizeX;
+    const size_t mInputSizeY;
+    // How many input cells each output cell covers, in each direction.
+    const float mScaleX;
+    const float mScaleY;
+    // Whether the input is unpremultiplied RGBA, which is premultiplied as it's summed. The
+    // output is premultiplied either way.
+    const bool mPremultiply;
+    // Per thread area to store the sum of the input rows covered by an output row.
+    std::vector<std::vector<float>> mRowSums;
+
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
+
+   public:
+    AreaDownscaleTask(const uint8_t* in, uint8_t* out, size_t inputSizeX, size_t inputSizeY,
+                      size_t vectorSize, size_t outputSizeX, size_t outputSizeY,
+                      uint32_t threadCount, AlphaMode alphaMode)
+        : Task{outputSizeX, outputSizeY, vectorSize, false, nullptr},
+          mIn{in},
+          mOut{out},
+          mInputSizeX{inputSizeX},
+          mInputSizeY{inputSizeY},
+          mScaleX{(float)inputSizeX / outputSizeX},
+          mScaleY{(float)inputSizeY / outputSizeY},
+          mPremultiply{vectorSize == 4 && alphaMode == AlphaMode::Unpremultiplied},
+          mRowSums{threadCount} {}
+};
+
+void AreaDownscaleTask::processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                                    size_t endY) {
+    std::vector<float>& sums = mRowSums[threadIndex];
+    const size_t inputStride = mInputSizeX * mVectorSize;
+    // Only the input columns covered by this tile need to be summed.
+    const size_t firstColumn = (size_t)(startX * mScaleX);
+    const size_t endColumn = std::min(mInputSizeX, (size_t)ceilf(endX * mScaleX));
+    sums.resize(inputStride);
+
+    for (size_t y = startY; y < endY; y++) {
+        // Sum the input rows covered by this output row, weighted by how much they're covered.
+        const float top = y * mScaleY;
+        const float bottom = std::min((float)mInputSizeY, (y + 1) * mScaleY);
+        std::fill(sums.begin() + firstColumn * mVectorSize, sums.begin() + endColumn * mVectorSize,
+                  0.0f);
+        for (size_t row = (size_t)top; (float)row < bottom && row < mInputSizeY; row++) {
+            const float weight = std::min(bottom, row + 1.0f) - std::max(top, (float)row);
+            const uchar* in = mIn + row * inputStride;
+            if (mPremultiply) {
+                const float* premultiply = premultiplyTable();
+                for (size_t i = firstColumn * 4; i < endColumn * 4; i += 4) {
+                    const float colorWeight = weight * premultiply[in[i + 3]];
+                    sums[i] += in[i] * colorWeight;
+                    sums[i + 1] += in[i + 1] * colorWeight;
+                    sums[i + 2] += in[i + 2] * colorWeight;
+                    sums[i + 3] += in[i + 3] * weight;
+                }
+                continue;
+            }
+            for (size_t i = firstColumn * mVectorSize; i < endColumn * mVectorSize; i++) {
+                sums[i] += in[i] * weight;
+            }
+        }
+
+        // Then do the same horizontally, and normalize by the area.
+        uchar* out = mOut + (mSizeX * y + startX) * mVectorSize;
+        for (size_t x = startX; x < endX; x++) {
+            const float left = x * mScaleX;
+            const float right = std::min((float)mInputSizeX, (x + 1) * mScaleX);
+            const float normalize = 1.0f / ((right - left) * (bottom - top));
+            for (size_t c = 0; c < mVectorSize; c++) {
+                float sum = 0.0f;
+                for (size_t column = (size_t)left; (float)column < right && column < mInputSizeX;
+                     column++) {
+                    const float weight =
+                            std::min(right, column + 1.0f) - std::max(left, (float)column);
+                    sum += sums[column * mVectorSize + c] * weight;
+                }
+                out[c] = (uchar)clamp(sum * normalize + 0.5f, 0.0f, 255.0f);
+            }
+            out += mVectorSize;
+        }
+    }
+}
+
+// The number of pixels an operation processes, for the metrics.
+static uint64_t pixelCount(size_t sizeX, size_t sizeY, const Restriction* restriction) {
+    if (restriction == nullptr) {
+        return (uint64_t)sizeX * sizeY;
+    }
+    return (uint64_t)(restriction->endX - restriction->startX) *
+           (restriction->endY - restriction->startY);
+}
+
+// Close to thermal throttling, linear light blurs are done on the encoded values instead, which
+// is cheaper. The level is the one set by the previous task, which is recent enough.
+static BlurSpace thermallyAdjusted(const TaskProcessor* processor, BlurSpace blurSpace) {
+    return processor->getThermalLevel() >= 2 ? BlurSpace::Encoded : blurSpace;
+}
+
+/**
+ * Blurs areas of an image with a BlurTask, areaCount of them, or the whole image if areas is
+ * null.
+ */
+static void runBlurTask(TaskProcessor* processor, const uint8_t* in, uint8_t* out, size_t sizeX,
+                        size_t sizeY, size_t vectorSize, int radius, const Restriction* areas,
+                        size_t areaCount, AlphaMode alphaMode, BlurSpace blurSpace,
+                        bool planarRgba, const ClipShape* clip = nullptr) {
+    blurSpace = thermallyAdjusted(processor, blurSpace);
+    BlurTask task(in, out, sizeX, sizeY, vectorSize, processor->getNumberOfThreads(), radius,
+                  areas, alphaMode, blurSpace, areaCount);
+    task.setClip(clip);
+    // The U_8 kernels keep the vertical pass of a row on the stack, up to 8192 cells.
+    task.setRgbaAsPlanes(planarRgba && vectorSize == 4 && alphaMode == AlphaMode::Premultiplied &&
+                         blurSpace == BlurSpace::Encoded && clip == nullptr && sizeX <= 8192);
+    processor->doTask(&task);
 }
 
 void RenderScriptToolkit::blur(const uint8_t* in, uint8_t* out, size_t sizeX, size_t sizeY,
                                size_t vectorSize, int radius, const Restriction* restriction) {
+    blur(in, out, sizeX, sizeY, vectorSize, radius, restriction, AlphaMode::Premultiplied);
+}
+
+void RenderScriptToolkit::blur(const uint8_t* in, uint8_t* out, size_t sizeX, size_t sizeY,
+                               size_t vectorSize, int radius, const Restriction* restriction,
+                               AlphaMode alphaMode, BlurSpace blurSpace) {
+    ScopedOpMetrics metrics(MetricsOp::Blur, pixelCount(sizeX, sizeY, restriction));
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
+        return;
+    }
+    if (radius <= 0 || radius > 25) {
+        ALOGE("The radius should be between 1 and 25. %d provided.", radius);
+    }
+    if (vectorSize != 1 && vectorSize != 3 && vectorSize != 4) {
+        ALOGE("The vectorSize should be 1, 3, or 4. %zu provided.", vectorSize);
+    }
+#endif
+
+    runBlurTask(processor.get(), in, out, sizeX, sizeY, vectorSize, radius, restriction, 1,
+                alphaMode, blurSpace, planarRgba);
+}
+
+void RenderScriptToolkit::blurRegions(const uint8_t* in, uint8_t* out, size_t sizeX,
+                                      size_t sizeY, size_t vectorSize, int radius,
+                                      const Restriction* regions, size_t regionCount,
+                                      AlphaMode alphaMode, BlurSpace blurSpace) {
+    uint64_t pixels = 0;
+    for (size_t i = 0; i < regionCount; i++) {
+        pixels += pixelCount(sizeX, sizeY, &regions[i]);
+    }
+    ScopedOpMetrics metrics(MetricsOp::BlurRegions, pixels);
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    for (size_t i = 0; i < regionCount; i++) {
+        if (!validRestriction(LOG_TAG, sizeX, sizeY, &regions[i])) {
+            return;
+        }
+    }
+    if (radius <= 0 || radius > 25) {
+        ALOGE("The radius should be between 1 and 25. %d provided.", radius);
+    }
+    if (vectorSize != 1 && vectorSize != 3 && vectorSize != 4) {
+        ALOGE("The vectorSize should be 1, 3, or 4. %zu provided.", vectorSize);
+    }
+#endif
+    if (regionCount == 0) {
+        return;
+    }
+
+    runBlurTask(processor.get(), in, out, sizeX, sizeY, vectorSize, radius, regions, regionCount,
+                alphaMode, blurSpace, planarRgba);
+}
+
+void RenderScriptToolkit::blurScrolled(const uint8_t* in, uint8_t* out, size_t sizeX,
+                                       size_t sizeY, size_t vectorSize, int radius, int dy,
+                                       AlphaMode alphaMode, BlurSpace blurSpace) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (radius <= 0 || radius > 25) {
+        ALOGE("The radius should be between 1 and 25. %d provided.", radius);
+    }
+    if (vectorSize != 1 && vectorSize != 3 && vectorSize != 4) {
+        ALOGE("The vectorSize should be 1, 3, or 4. %zu provided.", vectorSize);
+    }
+#endif
+    const size_t shift = static_cast<size_t>(dy < 0 ? -dy : dy);
+    // Past this, the rows to blur again are about as many as the whole image.
+    if (shift + 4 * static_cast<size_t>(radius) >= sizeY) {
+        blur(in, out, sizeX, sizeY, vectorSize, radius, nullptr, alphaMode, blurSpace);
+        return;
+    }
+
+    // Row y of the new blur is row y + dy of the previous one, as long as the windows of both
+    // don't reach an edge of the image.
+    const size_t rowSize = sizeX * vectorSize;
+    const size_t r = static_cast<size_t>(radius);
+    Restriction regions[2];
+    if (dy > 0) {
+        memmove(out, out + shift * rowSize, (sizeY - shift) * rowSize);
+        regions[0] = Restriction{0, sizeX, 0, r};
+        regions[1] = Restriction{0, sizeX, sizeY - shift - r, sizeY};
+    } else if (dy < 0) {
+        memmove(out + shift * rowSize, out, (sizeY - shift) * rowSize);
+        regions[0] = Restriction{0, sizeX, 0, shift + r};
+        regions[1] = Restriction{0, sizeX, sizeY - r, sizeY};
+    } else {
+        return;
+    }
+
+    ScopedOpMetrics metrics(MetricsOp::BlurScrolled, sizeX * (shift + 2 * r));
+    runBlurTask(processor.get(), in, out, sizeX, sizeY, vectorSize, radius, regions, 2, alphaMode,
+                blurSpace, planarRgba);
+}
+
+void RenderScriptToolkit::blurClipped(const uint8_t* in, uint8_t* out, size_t sizeX,
+                                      size_t sizeY, size_t vectorSize, int radius,
+                                      const ClipShape& clip, const Restriction* restriction,
+                                      AlphaMode alphaMode, BlurSpace blurSpace) {
+    ScopedOpMetrics metrics(MetricsOp::BlurClipped, pixelCount(sizeX, sizeY, restriction));
 #ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
     if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
         return;
@@ -530,12 +1551,185 @@ void RenderScriptToolkit::blur(const uint8_t* in, uint8_t* out, size_t sizeX, si
         ALOGE("The radius should be between 1 and 25. %d provided.", radius);
     }
     if (vectorSize != 1 && vectorSize != 4) {
-        ALOGE("The vectorSize should be 1 or 4. %zu provided.", vectorSize);
+        ALOGE("The vectorSize should be 1 or 4, as the edges are faded through alpha. %zu "
+              "provided.", vectorSize);
+        return;
+    }
+    if (clip.mask == nullptr && !(clip.cornerRadius >= 0.0f)) {
+        ALOGE("The cornerRadius should not be negative. %f provided.", clip.cornerRadius);
+        return;
     }
 #endif
 
-    BlurTask task(in, out, sizeX, sizeY, vectorSize, processor->getNumberOfThreads(), radius,
-                  restriction);
+    // Rows and columns the clip does not reach are not even tiled.
+    Restriction bounds;
+    if (!clipBounds(clip, sizeX, sizeY, restriction, &bounds)) {
+        return;
+    }
+    runBlurTask(processor.get(), in, out, sizeX, sizeY, vectorSize, radius, &bounds, 1, alphaMode,
+                blurSpace, false, &clip);
+}
+
+void RenderScriptToolkit::blurAndDownscale(const uint8_t* in, uint8_t* out, size_t sizeX,
+                                           size_t sizeY, size_t vectorSize, size_t outputSizeX,
+                                           size_t outputSizeY, int radius, AlphaMode alphaMode) {
+    ScopedOpMetrics metrics(MetricsOp::BlurAndDownscale, pixelCount(sizeX, sizeY, nullptr));
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (radius <= 0 || radius > 25) {
+        ALOGE("The radius should be between 1 and 25. %d provided.", radius);
+    }
+    if (vectorSize != 1 && vectorSize != 3 && vectorSize != 4) {
+        ALOGE("The vectorSize should be 1, 3, or 4. %zu provided.", vectorSize);
+    }
+    if (outputSizeX == 0 || outputSizeY == 0 || outputSizeX > sizeX || outputSizeY > sizeY) {
+        ALOGE("The output size should be between 1x1 and the input size %zux%zu. %zux%zu "
+              "provided.", sizeX, sizeY, outputSizeX, outputSizeY);
+        return;
+    }
+#endif
+    if (outputSizeX == sizeX && outputSizeY == sizeY) {
+        blur(in, out, sizeX, sizeY, vectorSize, radius, nullptr, alphaMode);
+        return;
+    }
+
+    // The output is a gaussian blur of the input followed by a downscale. We instead average
+    // the area of each output cell, which both decimates and prefilters the input, and only
+    // then blur at the output resolution. Most of the work is done on the smaller image.
+    // Unpremultiplied cells are premultiplied by the averaging, so that transparent cells don't
+    // bleed, and unpremultiplied again as the blur stores them.
+    const bool unpremultiply = vectorSize == 4 && alphaMode == AlphaMode::Unpremultiplied;
+    LargeBuffer downscaled(outputSizeX * outputSizeY * vectorSize);
+    AreaDownscaleTask downscale(in, downscaled.data(), sizeX, sizeY, vectorSize, outputSizeX,
+                                outputSizeY, processor->getNumberOfThreads(), alphaMode);
+    processor->doTask(&downscale);
+
+    // BlurTask blurs both axes alike, so an anisotropic downscale is blurred at the coarser
+    // scale. The other axis then gets a little less blur than asked, rather than more.
+    const float scale = std::max((float)sizeX / outputSizeX, (float)sizeY / outputSizeY);
+    const float outputRadius = downscaledBlurRadius(radius, scale);
+    if (outputRadius <= 0.0f) {
+        // Blurring would not add anything that the averaging didn't already do.
+        memcpy(out, downscaled.data(), downscaled.size());
+        if (unpremultiply) {
+            unpremultiplyRow((uchar4*)out, outputSizeX * outputSizeY);
+        }
+        return;
+    }
+    BlurTask task(downscaled.data(), out, outputSizeX, outputSizeY, vectorSize,
+                  processor->getNumberOfThreads(), outputRadius, nullptr,
+                  unpremultiply ? AlphaMode::Unpremultiplied : AlphaMode::Premultiplied);
+    task.setInputPremultiplied(unpremultiply);
+    processor->doTask(&task);
+}
+
+/**
+ * Upscales an image with bilinear interpolation. Used to bring a blur done at a lower
+ * resolution back to full size, which interpolating smooth content hardly degrades.
+ */
+class BilinearUpscaleTask : public Task {
+    const uchar* mIn;
+    uchar* mOut;
+    const size_t mInputSizeX;
+    const size_t mInputSizeY;
+    // How many input cells each output cell covers, in each direction. Less than 1.
+    const float mScaleX;
+    const float mScaleY;
+    // Whether the cells are unpremultiplied RGBA. They're then premultiplied as they're loaded
+    // and unpremultiplied as they're stored, so that transparent colors don't bleed.
+    const bool mUnpremultiplied;
+
+    // Process a 2D tile of the overall work. threadIndex identifies which thread does the work.
+    void processData(int threadIndex, size_t startX, size_t startY, size_t endX,
+                     size_t endY) override;
+
+   public:
+    BilinearUpscaleTask(const uint8_t* in, uint8_t* out, size_t inputSizeX, size_t inputSizeY,
+                        size_t vectorSize, size_t outputSizeX, size_t outputSizeY,
+                        AlphaMode alphaMode)
+        : Task{outputSizeX, outputSizeY, vectorSize, false, nullptr},
+          mIn{in},
+          mOut{out},
+          mInputSizeX{inputSizeX},
+          mInputSizeY{inputSizeY},
+          mScaleX{(float)inputSizeX / outputSizeX},
+          mScaleY{(float)inputSizeY / outputSizeY},
+          mUnpremultiplied{vectorSize == 4 && alphaMode == AlphaMode::Unpremultiplied} {}
+};
+
+void BilinearUpscaleTask::processData(int /*threadIndex*/, size_t startX, size_t startY,
+                                      size_t endX, size_t endY) {
+    for (size_t y = startY; y < endY; y++) {
+        // Align the centers of the cells, and clamp at the edges.
+        const float sourceY = std::max(0.0f, (y + 0.5f) * mScaleY - 0.5f);
+        const size_t y0 = std::min((size_t)sourceY, mInputSizeY - 1);
+        const size_t y1 = std::min(y0 + 1, mInputSizeY - 1);
+        const float fy = std::min(sourceY - y0, 1.0f);
+        const uchar* row0 = mIn + mInputSizeX * y0 * mVectorSize;
+        const uchar* row1 = mIn + mInputSizeX * y1 * mVectorSize;
+        uchar* out = mOut + (mSizeX * y + startX) * mVectorSize;
+        for (size_t x = startX; x < endX; x++) {
+            const float sourceX = std::max(0.0f, (x + 0.5f) * mScaleX - 0.5f);
+            const size_t x0 = std::min((size_t)sourceX, mInputSizeX - 1);
+            const size_t x1 = std::min(x0 + 1, mInputSizeX - 1);
+            const float fx = std::min(sourceX - x0, 1.0f);
+            if (mUnpremultiplied) {
+                const float* premultiply = premultiplyTable();
+                const uchar4* cells0 = (const uchar4*)row0;
+                const uchar4* cells1 = (const uchar4*)row1;
+                const float4 topLeft = loadU4(cells0[x0], premultiply);
+                const float4 bottomLeft = loadU4(cells1[x0], premultiply);
+                const float4 top = topLeft + (loadU4(cells0[x1], premultiply) - topLeft) * fx;
+                const float4 bottom =
+                        bottomLeft + (loadU4(cells1[x1], premultiply) - bottomLeft) * fx;
+                const float4 f = top + (bottom - top) * fy;
+                // Divided by the interpolated alpha rather than its rounded byte, so that an
+                // opaque color doesn't drift where it fades out.
+                float4 straight = f * (f.w > 0.0f ? 255.0f / f.w : 0.0f) + 0.5f;
+                straight.w = f.w + 0.5f;
+                *(uchar4*)out = convert<uchar4>(clamp(straight, 0.0f, 255.0f));
+                out += 4;
+                continue;
+            }
+            for (size_t c = 0; c < mVectorSize; c++) {
+                const float top = row0[x0 * mVectorSize + c] +
+                                  (row0[x1 * mVectorSize + c] - row0[x0 * mVectorSize + c]) * fx;
+                const float bottom =
+                        row1[x0 * mVectorSize + c] +
+                        (row1[x1 * mVectorSize + c] - row1[x0 * mVectorSize + c]) * fx;
+                out[c] = (uchar)(top + (bottom - top) * fy + 0.5f);
+            }
+            out += mVectorSize;
+        }
+    }
+}
+
+void RenderScriptToolkit::upscale(const uint8_t* in, uint8_t* out, size_t sizeX, size_t sizeY,
+                                  size_t vectorSize, size_t outputSizeX, size_t outputSizeY,
+                                  AlphaMode alphaMode) {
+    BilinearUpscaleTask task(in, out, sizeX, sizeY, vectorSize, outputSizeX, outputSizeY,
+                             alphaMode);
+    processor->doTask(&task);
+}
+
+void RenderScriptToolkit::blurPlanar(const uint8_t* const* in, uint8_t* const* out,
+                                     size_t planeCount, size_t sizeX, size_t sizeY, int radius,
+                                     const Restriction* restriction) {
+    ScopedOpMetrics metrics(MetricsOp::BlurPlanar, pixelCount(sizeX, sizeY, restriction));
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (!validRestriction(LOG_TAG, sizeX, sizeY, restriction)) {
+        return;
+    }
+    if (radius <= 0 || radius > 25) {
+        ALOGE("The radius should be between 1 and 25. %d provided.", radius);
+    }
+    if (planeCount < 1 || planeCount > 4) {
+        ALOGE("The planeCount should be between 1 and 4. %zu provided.", planeCount);
+        return;
+    }
+#endif
+
+    BlurTask task(in, out, planeCount, sizeX, sizeY, processor->getNumberOfThreads(),
+                  radius, restriction);
     processor->doTask(&task);
 }
 
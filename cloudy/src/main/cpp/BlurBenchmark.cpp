@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Metrics.h"
+#include "RenderScriptToolkit.h"
+#include "TaskProcessor.h"
+#include "Utils.h"
+
+#define LOG_TAG "renderscript.toolkit.BlurBenchmark"
+
+namespace renderscript {
+
+namespace {
+
+// The grid of the benchmark. Changing it changes the cells the comparator can match, so only
+// add to it.
+constexpr int kRadii[] = {2, 8, 16, 25};
+constexpr size_t kSizes[][2] = {{512, 512}, {1080, 1920}};
+
+// The cells and modes measured for each size and radius. The modes only apply to RGBA. The mode
+// is part of the key of a result; results without one are "premultiplied". Each variant forces
+// ThreadingConfiguration::planarRgba, so that "premultiplied" always measures the interleaved
+// kernels and "planar" the single channel ones, whatever calibrate() picked.
+struct Variant {
+    size_t vectorSize;
+    const char* mode;
+    AlphaMode alphaMode;
+    BlurSpace blurSpace;
+    bool planarRgba;
+};
+constexpr Variant kVariants[] = {
+        {1, "premultiplied", AlphaMode::Premultiplied, BlurSpace::Encoded, false},
+        {3, "premultiplied", AlphaMode::Premultiplied, BlurSpace::Encoded, false},
+        {4, "premultiplied", AlphaMode::Premultiplied, BlurSpace::Encoded, false},
+        {4, "unpremultiplied", AlphaMode::Unpremultiplied, BlurSpace::Encoded, false},
+        {4, "linear", AlphaMode::Premultiplied, BlurSpace::Linear, false},
+        {4, "planar", AlphaMode::Premultiplied, BlurSpace::Encoded, true},
+};
+
+// Returns the CPU model from /proc/cpuinfo, e.g. the "Hardware" line on ARM or the "model name"
+// line on x86.
+std::string cpuModel() {
+    FILE* file = fopen("/proc/cpuinfo", "r");
+    if (file == nullptr) {
+        return "unknown";
+    }
+    std::string model = "unknown";
+    char line[256];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (strncmp(line, "Hardware", 8) != 0 && strncmp(line, "model name", 10) != 0) {
+            continue;
+        }
+        const char* value = strchr(line, ':');
+        if (value == nullptr) {
+            continue;
+        }
+        value++;
+        while (*value == ' ' || *value == '\t') {
+            value++;
+        }
+        model.assign(value, strcspn(value, "\n"));
+        if (strncmp(line, "Hardware", 8) == 0) {
+            // The SoC name is more useful than the name of the cores.
+            break;
+        }
+    }
+    fclose(file);
+    return model;
+}
+
+// Escapes the characters JSON doesn't allow in strings.
+std::string jsonString(const std::string& value) {
+    std::string escaped = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if ((unsigned char)c >= 0x20) {
+            escaped += c;
+        }
+    }
+    return escaped + "\"";
+}
+
+// Formats a counter, or null if it's not available.
+std::string jsonCounter(double value) {
+    if (std::isnan(value)) {
+        return "null";
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.3f", value);
+    return buffer;
+}
+
+std::string jsonCounter(int64_t value) {
+    return value < 0 ? "null" : std::to_string(value);
+}
+
+}  // namespace
+
+std::string RenderScriptToolkit::benchmarkBlur(int iterations, bool counters) {
+    iterations = std::max(2, iterations);
+    const ThreadingConfiguration threading = getThreadingConfiguration();
+
+    std::string json;
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer),
+             "{\n  \"schemaVersion\": 1,\n  \"cpu\": {\"model\": %s, \"cores\": %u, "
+             "\"simd\": %s},\n  \"threads\": %d,\n  \"tileSizeInBytes\": %d,\n"
+             "  \"planarRgba\": %s,\n  \"results\": [",
+             jsonString(cpuModel()).c_str(), std::thread::hardware_concurrency(),
+             cpuSupportsSimd() ? "true" : "false", threading.threadCount,
+             threading.tileSizeInBytes, threading.planarRgba ? "true" : "false");
+    json += buffer;
+
+    bool firstResult = true;
+    for (const auto& size : kSizes) {
+        const size_t sizeX = size[0];
+        const size_t sizeY = size[1];
+        std::vector<uint8_t> in(sizeX * sizeY * 4);
+        std::vector<uint8_t> out(in.size());
+        uint32_t seed = 1;
+        for (uint8_t& value : in) {
+            seed = seed * 1664525u + 1013904223u;
+            value = static_cast<uint8_t>(seed >> 24);
+        }
+
+        for (const Variant& variant : kVariants) {
+            const size_t vectorSize = variant.vectorSize;
+            planarRgba = variant.planarRgba;
+            for (int radius : kRadii) {
+                // Warm up, then count the kernel paths of the measured runs only.
+                blur(in.data(), out.data(), sizeX, sizeY, vectorSize, radius, nullptr,
+                     variant.alphaMode, variant.blurSpace);
+                uint64_t rowsBefore[kKernelPathCount];
+                for (size_t p = 0; p < kKernelPathCount; p++) {
+                    rowsBefore[p] = MetricsRegistry::get().getKernelRows((KernelPath)p);
+                }
+
+                std::vector<double> samples;
+                for (int i = 0; i < iterations; i++) {
+                    const auto start = std::chrono::steady_clock::now();
+                    blur(in.data(), out.data(), sizeX, sizeY, vectorSize, radius, nullptr,
+                         variant.alphaMode, variant.blurSpace);
+                    const std::chrono::duration<double, std::micro> elapsed =
+                            std::chrono::steady_clock::now() - start;
+                    // Pixels per microsecond are megapixels per second.
+                    samples.push_back(sizeX * sizeY / std::max(elapsed.count(), 1e-3));
+                }
+
+                // The path that processed the most rows.
+                size_t mainPath = 0;
+                uint64_t mainPathRows = 0;
+                for (size_t p = 0; p < kKernelPathCount; p++) {
+                    const uint64_t rows =
+                            MetricsRegistry::get().getKernelRows((KernelPath)p) - rowsBefore[p];
+                    if (rows > mainPathRows) {
+                        mainPath = p;
+                        mainPathRows = rows;
+                    }
+                }
+
+                double mean = 0.0;
+                for (double sample : samples) {
+                    mean += sample;
+                }
+                mean /= samples.size();
+                double variance = 0.0;
+                for (double sample : samples) {
+                    variance += (sample - mean) * (sample - mean);
+                }
+                variance /= samples.size() - 1;
+                std::vector<double> sorted = samples;
+                std::sort(sorted.begin(), sorted.end());
+                const double median = sorted[sorted.size() / 2];
+
+                snprintf(buffer, sizeof(buffer),
+                         "%s\n    {\"radius\": %d, \"sizeX\": %zu, \"sizeY\": %zu, "
+                         "\"vectorSize\": %zu, \"mode\": \"%s\", \"kernelPath\": \"%s\", "
+                         "\"iterations\": %d,\n"
+                         "     \"mpixPerSecond\": {\"median\": %.3f, \"mean\": %.3f, "
+                         "\"variance\": %.5f, \"min\": %.3f, \"max\": %.3f},\n"
+                         "     \"samples\": [",
+                         firstResult ? "" : ",", radius, sizeX, sizeY, vectorSize, variant.mode,
+                         kernelPathName(static_cast<KernelPath>(mainPath)), iterations, median,
+                         mean, variance, sorted.front(), sorted.back());
+                json += buffer;
+                for (size_t i = 0; i < samples.size(); i++) {
+                    snprintf(buffer, sizeof(buffer), "%s%.3f", i == 0 ? "" : ", ", samples[i]);
+                    json += buffer;
+                }
+                json += "]";
+                if (counters) {
+                    // Measured after the kernel paths were counted, as it blurs again.
+                    const BlurProfile profile =
+                            profileBlur(in.data(), out.data(), sizeX, sizeY, vectorSize, radius,
+                                        nullptr, variant.alphaMode, variant.blurSpace);
+                    json += ",\n     \"counters\": {\"instructionsPerCycle\": " +
+                            jsonCounter(profile.instructionsPerCycle) +
+                            ", \"bytesPerPixel\": " + jsonCounter(profile.bytesPerPixel) +
+                            ", \"l1DataMisses\": " + jsonCounter(profile.l1DataMisses) +
+                            ", \"lastLevelCacheMisses\": " +
+                            jsonCounter(profile.lastLevelCacheMisses) + "}";
+                }
+                json += "}";
+                firstResult = false;
+            }
+        }
+    }
+    planarRgba = threading.planarRgba;
+    json += "\n  ]\n}\n";
+    return json;
+}
+
+}  // namespace renderscript
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BlurBudget.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Metrics.h"
+#include "RenderScriptToolkit.h"
+#include "TaskProcessor.h"
+#include "Utils.h"
+
+#define LOG_TAG "renderscript.toolkit.BlurBudget"
+
+namespace renderscript {
+
+namespace {
+
+// The cost model is calibrated on an RGBA image of this size, like calibrate().
+constexpr size_t kCalibrationSizeX = 512;
+constexpr size_t kCalibrationSizeY = 512;
+constexpr size_t kCalibrationPixels = kCalibrationSizeX * kCalibrationSizeY;
+// The two radii we fit the per pixel and per tap costs on.
+constexpr int kSmallRadius = 2;
+constexpr int kLargeRadius = 25;
+// The downscale factors blurWithinBudget() tries, from the best quality to the cheapest.
+constexpr int kDownscaleFactors[] = {2, 4, 8};
+// How much each call moves the correction of the cost model.
+constexpr double kCorrectionWeight = 0.2;
+
+// Returns the fastest of a few runs of the function, in nanoseconds.
+template <typename Function>
+double fastestNs(Function function) {
+    function();  // Warm up.
+    double fastest = std::numeric_limits<double>::max();
+    for (int run = 0; run < 3; run++) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const std::chrono::duration<double, std::nano> elapsed =
+                std::chrono::steady_clock::now() - start;
+        fastest = std::min(fastest, elapsed.count());
+    }
+    return fastest;
+}
+
+}  // namespace
+
+void RenderScriptToolkit::prepareBlurWithinBudget() {
+    // Calibrate without holding the lock, so that blurWithinBudget() keeps going with the
+    // current model meanwhile.
+    const BlurCostModel model = calibrateCostModel();
+    std::lock_guard<std::mutex> lock(costModelMutex);
+    *costModel = model;
+}
+
+BlurCostModel RenderScriptToolkit::calibrateCostModel() {
+    // The calibration blurs are not the app's.
+    ScopedMetricsSuppression suppression;
+    std::vector<uint8_t> in(kCalibrationPixels * 4);
+    std::vector<uint8_t> out(in.size());
+    uint32_t seed = 1;
+    for (uint8_t& value : in) {
+        seed = seed * 1664525u + 1013904223u;
+        value = static_cast<uint8_t>(seed >> 24);
+    }
+    auto timeBlur = [&](size_t vectorSize, int radius, BlurSpace space) {
+        return fastestNs([&]() {
+            blur(in.data(), out.data(), kCalibrationSizeX, kCalibrationSizeY, vectorSize,
+                 radius, nullptr, AlphaMode::Premultiplied, space);
+        });
+    };
+
+    BlurCostModel model;
+    const double small = timeBlur(4, kSmallRadius, BlurSpace::Encoded);
+    const double large = timeBlur(4, kLargeRadius, BlurSpace::Encoded);
+    const double smallTaps = 2 * kSmallRadius + 1;
+    const double largeTaps = 2 * kLargeRadius + 1;
+    model.perTapNs =
+            std::max(0.0, (large - small) / (kCalibrationPixels * (largeTaps - smallTaps)));
+    model.baseNs = std::max(0.0, small / kCalibrationPixels - model.perTapNs * smallTaps);
+    model.linearFactor = timeBlur(4, kLargeRadius, BlurSpace::Linear) / large;
+    model.singleChannelFactor = timeBlur(1, kLargeRadius, BlurSpace::Encoded) / large;
+
+    // With a radius this small, blurAndDownscale() only averages, see downscaledBlurRadius().
+    const size_t smallSizeX = kCalibrationSizeX / 4;
+    const size_t smallSizeY = kCalibrationSizeY / 4;
+    model.downscaleNs = fastestNs([&]() {
+                            blurAndDownscale(in.data(), out.data(), kCalibrationSizeX,
+                                             kCalibrationSizeY, 4, smallSizeX, smallSizeY, 1);
+                        }) /
+                        kCalibrationPixels;
+    model.upscaleNs = fastestNs([&]() {
+                          upscale(out.data(), in.data(), smallSizeX, smallSizeY, 4,
+                                  kCalibrationSizeX, kCalibrationSizeY);
+                      }) /
+                      kCalibrationPixels;
+    return model;
+}
+
+BlurStrategy RenderScriptToolkit::blurWithinBudget(const uint8_t* in, uint8_t* out, size_t sizeX,
+                                                   size_t sizeY, size_t vectorSize, int radius,
+                                                   int64_t budgetMicros, AlphaMode alphaMode,
+                                                   BlurSpace blurSpace) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (radius <= 0 || radius > 25) {
+        ALOGE("The radius should be between 1 and 25. %d provided.", radius);
+    }
+    if (vectorSize != 1 && vectorSize != 3 && vectorSize != 4) {
+        ALOGE("The vectorSize should be 1, 3, or 4. %zu provided.", vectorSize);
+    }
+#endif
+
+    BlurCostModel model;
+    {
+        std::lock_guard<std::mutex> lock(costModelMutex);
+        model = *costModel;
+    }
+
+    // The candidates, from the best quality to the cheapest. Take the first that fits.
+    const size_t pixels = sizeX * sizeY;
+    std::vector<BlurStrategy> candidates;
+    candidates.push_back(BlurStrategy{
+            1, blurSpace, (float)model.blurMicros(pixels, radius, vectorSize, blurSpace), 0.0f});
+    if (blurSpace == BlurSpace::Linear && vectorSize == 4) {
+        candidates.push_back(BlurStrategy{
+                1, BlurSpace::Encoded,
+                (float)model.blurMicros(pixels, radius, vectorSize, BlurSpace::Encoded), 0.0f});
+    }
+    for (int factor : kDownscaleFactors) {
+        if (sizeX / factor == 0 || sizeY / factor == 0) {
+            break;
+        }
+        const size_t smallPixels = (sizeX / factor) * (sizeY / factor);
+        const float smallRadius = downscaledBlurRadius(radius, (float)factor);
+        candidates.push_back(BlurStrategy{
+                factor, BlurSpace::Encoded,
+                (float)(model.downscaleMicros(pixels, pixels) +
+                        model.blurMicros(smallPixels, smallRadius, vectorSize,
+                                         BlurSpace::Encoded)),
+                0.0f});
+    }
+    BlurStrategy strategy = candidates.front();
+    for (const BlurStrategy& candidate : candidates) {
+        strategy = candidate;
+        if (candidate.predictedMicros <= budgetMicros) {
+            break;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    if (strategy.downscaleFactor == 1) {
+        blur(in, out, sizeX, sizeY, vectorSize, radius, nullptr, alphaMode, strategy.blurSpace);
+    } else {
+        const size_t smallSizeX = sizeX / strategy.downscaleFactor;
+        const size_t smallSizeY = sizeY / strategy.downscaleFactor;
+        LargeBuffer small(smallSizeX * smallSizeY * vectorSize);
+        blurAndDownscale(in, small.data(), sizeX, sizeY, vectorSize, smallSizeX, smallSizeY,
+                         radius, alphaMode);
+        upscale(small.data(), out, smallSizeX, smallSizeY, vectorSize, sizeX, sizeY, alphaMode);
+    }
+    const std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - start;
+    strategy.measuredMicros = elapsed.count();
+
+    // Track how far off the model is, e.g. once the device heats up.
+    if (strategy.predictedMicros > 0.0f) {
+        std::lock_guard<std::mutex> lock(costModelMutex);
+        const double ratio = strategy.measuredMicros / strategy.predictedMicros;
+        costModel->correction *= 1.0 + kCorrectionWeight * (ratio - 1.0);
+    }
+    return strategy;
+}
+
+}  // namespace renderscript
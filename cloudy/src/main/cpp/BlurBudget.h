@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RENDERSCRIPT_TOOLKIT_BLURBUDGET_H
+#define ANDROID_RENDERSCRIPT_TOOLKIT_BLURBUDGET_H
+
+#include <cmath>
+#include <cstddef>
+
+#include "RenderScriptToolkit.h"
+
+namespace renderscript {
+
+/**
+ * Returns the radius to blur an image with once it has been downscaled by area averaging,
+ * so that the result matches a blur of the full resolution image with the given radius.
+ * Returns 0 or less if the averaging alone is enough.
+ *
+ * The radius maps to a sigma of 0.4 * radius + 0.6 input cells, see ComputeGaussianWeights().
+ * We scale the sigma to output cells, and remove the variance the box filter of the averaging
+ * already contributed, i.e. 1/12 of an output cell squared.
+ */
+inline float downscaledBlurRadius(int radius, float scale) {
+    const float sigma = (0.4f * radius + 0.6f) / scale;
+    const float remainingSigma = sqrtf(fmaxf(sigma * sigma - 1.0f / 12.0f, 0.0f));
+    return (remainingSigma - 0.6f) / 0.4f;
+}
+
+/**
+ * Predicts how long the blur strategies take on this device. See
+ * RenderScriptToolkit::blurWithinBudget().
+ *
+ * The blur does a vertical and a horizontal pass that each read 2 * radius + 1 cells per
+ * output cell, so its cost per pixel is modeled as base + perTap * (2 * radius + 1).
+ */
+struct BlurCostModel {
+    // The defaults are used until RenderScriptToolkit::prepareBlurWithinBudget() calibrates the
+    // model. They are deliberately pessimistic guesses, not measurements, so that an
+    // uncalibrated model picks a cheaper strategy rather than miss the budget. They're roughly
+    // a single slow core: a radius 25 blur of 1080x1920 RGBA is predicted at about 45 ms.
+
+    // Nanoseconds per pixel of a BlurSpace::Encoded blur of 4 byte cells.
+    double baseNs = 2.0;
+    double perTapNs = 0.4;
+    // The cost of a BlurSpace::Linear blur relative to an Encoded one.
+    double linearFactor = 3.0;
+    // The cost of blurring 1 byte cells relative to 4 byte cells.
+    double singleChannelFactor = 0.5;
+    // Nanoseconds per input pixel of the area averaging downscale.
+    double downscaleNs = 1.0;
+    // Nanoseconds per output pixel of the bilinear upscale.
+    double upscaleNs = 2.0;
+    // The ratio between the measured and predicted times of the recent calls, which tracks
+    // changes like thermal throttling since the calibration.
+    double correction = 1.0;
+
+    double blurMicros(size_t pixels, float radius, size_t vectorSize, BlurSpace space) const {
+        if (radius <= 0.0f) {
+            return 0.0;
+        }
+        double ns = pixels * (baseNs + perTapNs * (2.0 * radius + 1.0));
+        if (vectorSize == 1) {
+            ns *= singleChannelFactor;
+        }
+        if (space == BlurSpace::Linear && vectorSize == 4) {
+            ns *= linearFactor;
+        }
+        return ns * correction / 1000.0;
+    }
+
+    double downscaleMicros(size_t inputPixels, size_t outputPixels) const {
+        return (inputPixels * downscaleNs + outputPixels * upscaleNs) * correction / 1000.0;
+    }
+};
+
+}  // namespace renderscript
+
+#endif  // ANDROID_RENDERSCRIPT_TOOLKIT_BLURBUDGET_H
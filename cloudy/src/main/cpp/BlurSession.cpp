@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BlurSession.h"
+
+#include <string.h>
+
+#include <utility>
+
+#define LOG_TAG "renderscript.toolkit.BlurSession"
+
+namespace renderscript {
+
+BlurSession::BlurSession(RenderScriptToolkit* toolkit, size_t sizeX, size_t sizeY,
+                         size_t vectorSize, int radius, AlphaMode alphaMode,
+                         std::function<void(uint8_t*)> postProcess)
+    : mToolkit{toolkit},
+      mSizeX{sizeX},
+      mSizeY{sizeY},
+      mVectorSize{vectorSize},
+      mRadius{radius},
+      mAlphaMode{alphaMode},
+      mPostProcess{std::move(postProcess)} {
+    const size_t frameSize = sizeX * sizeY * vectorSize;
+    for (auto& input : mInputs) {
+        input = std::make_unique<LargeBuffer>(frameSize);
+    }
+    const int outputCount = mPostProcess ? 4 : 3;
+    for (int i = 0; i < outputCount; i++) {
+        mOutputs[i] = std::make_unique<LargeBuffer>(frameSize);
+    }
+    mThread = std::thread(&BlurSession::run, this);
+    if (mPostProcess) {
+        mPostProcessThread = std::thread(&BlurSession::runPostProcess, this);
+    }
+}
+
+BlurSession::~BlurSession() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWorkAvailable.notify_one();
+    mPostProcessChanged.notify_all();
+    mThread.join();
+    if (mPostProcessThread.joinable()) {
+        mPostProcessThread.join();
+    }
+}
+
+void BlurSession::submitFrame(const uint8_t* in, size_t strideInBytes) {
+    std::lock_guard<std::mutex> submitLock(mSubmitMutex);
+    int input;
+    {
+        // Fill the input that's not being blurred. If it held a pending frame, that frame is
+        // dropped. Clearing mPendingInput keeps the session thread from taking it meanwhile.
+        std::lock_guard<std::mutex> lock(mMutex);
+        input = mBlurringInput == 0 ? 1 : 0;
+        if (mPendingInput != -1) {
+            mDroppedFrameCount++;
+            mPendingInput = -1;
+        }
+    }
+
+    // The copy doubles as the conversion of captures whose rows are padded.
+    const size_t rowSize = mSizeX * mVectorSize;
+    uint8_t* out = mInputs[input]->data();
+    if (strideInBytes == 0 || strideInBytes == rowSize) {
+        memcpy(out, in, rowSize * mSizeY);
+    } else {
+        for (size_t y = 0; y < mSizeY; y++) {
+            memcpy(out + y * rowSize, in + y * strideInBytes, rowSize);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPendingInput = input;
+        mPendingFrameNumber = ++mSubmittedFrameCount;
+    }
+    mWorkAvailable.notify_one();
+}
+
+const uint8_t* BlurSession::acquireLatestFrame(uint64_t* frameNumber) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mReadyFrameNumber > mFrontFrameNumber) {
+        std::swap(mFrontOutput, mReadyOutput);
+        std::swap(mFrontFrameNumber, mReadyFrameNumber);
+    }
+    if (frameNumber != nullptr) {
+        *frameNumber = mFrontFrameNumber;
+    }
+    return mFrontFrameNumber == 0 ? nullptr : mOutputs[mFrontOutput]->data();
+}
+
+uint64_t BlurSession::getDroppedFrameCount() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mDroppedFrameCount;
+}
+
+void BlurSession::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mWorkAvailable.wait(lock, [this] { return mStopping || mPendingInput != -1; });
+        if (mStopping) {
+            return;
+        }
+        mBlurringInput = mPendingInput;
+        mPendingInput = -1;
+        const uint64_t frameNumber = mPendingFrameNumber;
+        // Only the session thread touches the back output, so it's safe to use unlocked.
+        uint8_t* out = mOutputs[mBackOutput]->data();
+        lock.unlock();
+
+        mToolkit->blur(mInputs[mBlurringInput]->data(), out, mSizeX, mSizeY, mVectorSize,
+                       mRadius, nullptr, mAlphaMode);
+
+        lock.lock();
+        // The input can take the next frame while we wait for the post-process thread.
+        mBlurringInput = -1;
+        if (!mPostProcess) {
+            std::swap(mBackOutput, mReadyOutput);
+            mReadyFrameNumber = frameNumber;
+            continue;
+        }
+        // Hand the frame over once the post-process thread is done with the previous one, and
+        // blur the next one meanwhile.
+        mPostProcessChanged.wait(lock,
+                                 [this] { return mStopping || mPostProcessFrameNumber == 0; });
+        if (mStopping) {
+            return;
+        }
+        std::swap(mBackOutput, mPostProcessOutput);
+        mPostProcessFrameNumber = frameNumber;
+        mPostProcessChanged.notify_all();
+    }
+}
+
+void BlurSession::runPostProcess() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mPostProcessChanged.wait(lock,
+                                 [this] { return mStopping || mPostProcessFrameNumber != 0; });
+        if (mStopping) {
+            return;
+        }
+        // Only this thread touches the post-process output while it holds a frame.
+        uint8_t* frame = mOutputs[mPostProcessOutput]->data();
+        lock.unlock();
+
+        mPostProcess(frame);
+
+        lock.lock();
+        std::swap(mPostProcessOutput, mReadyOutput);
+        mReadyFrameNumber = mPostProcessFrameNumber;
+        mPostProcessFrameNumber = 0;
+        mPostProcessChanged.notify_all();
+    }
+}
+
+}  // namespace renderscript
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RENDERSCRIPT_TOOLKIT_BLURSESSION_H
+#define ANDROID_RENDERSCRIPT_TOOLKIT_BLURSESSION_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "RenderScriptToolkit.h"
+#include "Utils.h"
+
+namespace renderscript {
+
+/**
+ * Blurs a continuously updating backdrop, always keeping the freshest frame.
+ *
+ * Frames can be submitted at any time with submitFrame(), which only copies them in. A session
+ * thread blurs them one at a time on the pool of the Toolkit. If asked, a second session thread
+ * post-processes each blurred frame before publishing it. A frame still pending when a newer one
+ * is submitted is dropped, so the blur never falls behind the source. The consumer takes the
+ * latest finished frame with acquireLatestFrame(), which never waits for a blur.
+ *
+ * The stages form a pipeline: while frame N is post-processed, frame N + 1 is blurred, frame
+ * N + 2 can be copied in, and the consumer can read frame N - 1. This is why there are two input
+ * buffers, and, besides the one the consumer holds, an output buffer for each stage plus the
+ * latest finished one. A frame goes through as fast as the slower of the two stages, rather
+ * than their sum. A blur that finishes while the previous frame is still post-processed waits
+ * for it, as dropping blurred frames would waste the blurs.
+ *
+ * The session needs a thread of its own because the Toolkit's doTask() blocks its caller until
+ * the whole blur is done, and the pool runs one task at a time. Blurring from submitFrame()
+ * would make producers wait; blurring from acquireLatestFrame() would make the consumer wait.
+ * The session thread only waits while the pool does the work.
+ */
+class BlurSession {
+   public:
+    /**
+     * @param toolkit The Toolkit that blurs the frames. Must outlive the session.
+     * @param postProcess If not null, called with each blurred frame before it's published, e.g.
+     *        to tint it. It runs on a thread of its own, alongside the blur of the next frame.
+     */
+    BlurSession(RenderScriptToolkit* _Nonnull toolkit, size_t sizeX, size_t sizeY,
+                size_t vectorSize, int radius, AlphaMode alphaMode = AlphaMode::Premultiplied,
+                std::function<void(uint8_t* _Nonnull)> postProcess = nullptr);
+    // Waits for the frames being blurred and post-processed, if any. Pending frames are dropped.
+    ~BlurSession();
+    BlurSession(const BlurSession&) = delete;
+    BlurSession& operator=(const BlurSession&) = delete;
+
+    /**
+     * Submit a new source frame, replacing the pending one if its blur hasn't started.
+     *
+     * @param in The frame, sizeX * sizeY cells.
+     * @param strideInBytes The distance between the rows of in, e.g. for a captured buffer whose
+     *        rows are padded. If 0, the rows are packed.
+     */
+    void submitFrame(const uint8_t* _Nonnull in, size_t strideInBytes = 0);
+
+    /**
+     * Returns the latest finished frame, or null if none has finished yet.
+     *
+     * The frame stays valid and unchanged until the next call, and can be the same as the one
+     * returned by the previous call if no newer frame has finished since.
+     *
+     * @param frameNumber If not null, set to the number of the returned frame. Frames are
+     *        numbered from 1 in the order they were submitted.
+     */
+    const uint8_t* _Nullable acquireLatestFrame(uint64_t* _Nullable frameNumber = nullptr);
+
+    /** Returns how many submitted frames were replaced by a newer one before being blurred. */
+    uint64_t getDroppedFrameCount();
+
+   private:
+    // The loops of the blur and post-process threads.
+    void run();
+    void runPostProcess();
+
+    RenderScriptToolkit* _Nonnull mToolkit;
+    const size_t mSizeX;
+    const size_t mSizeY;
+    const size_t mVectorSize;
+    const int mRadius;
+    const AlphaMode mAlphaMode;
+    const std::function<void(uint8_t* _Nonnull)> mPostProcess;
+
+    // Serializes the producers, so that two of them don't fill the same input.
+    std::mutex mSubmitMutex;
+    // Protects the indices and counters below, and signals the condition variables.
+    std::mutex mMutex;
+    // Signaled when a frame is submitted.
+    std::condition_variable mWorkAvailable;
+    // Signaled when a blurred frame is handed to the post-process thread, and when that thread
+    // is done with it.
+    std::condition_variable mPostProcessChanged;
+    bool mStopping = false;
+
+    std::unique_ptr<LargeBuffer> mInputs[2];
+    // The input holding the frame to blur next, and the one being blurred. -1 if none.
+    int mPendingInput = -1;
+    int mBlurringInput = -1;
+    uint64_t mPendingFrameNumber = 0;
+
+    // The output being blurred into, the latest finished one, the one the consumer holds, and
+    // the one being post-processed. They're swapped rather than copied. The last one is only
+    // allocated when there's a post-process.
+    std::unique_ptr<LargeBuffer> mOutputs[4];
+    int mBackOutput = 0;
+    int mReadyOutput = 1;
+    int mFrontOutput = 2;
+    int mPostProcessOutput = 3;
+    uint64_t mReadyFrameNumber = 0;
+    uint64_t mFrontFrameNumber = 0;
+    // The number of the frame in mPostProcessOutput, 0 once it's been published.
+    uint64_t mPostProcessFrameNumber = 0;
+
+    uint64_t mSubmittedFrameCount = 0;
+    uint64_t mDroppedFrameCount = 0;
+
+    std::thread mThread;
+    // Only started when there's a post-process.
+    std::thread mPostProcessThread;
+};
+
+}  // namespace renderscript
+
+#endif  // ANDROID_RENDERSCRIPT_TOOLKIT_BLURSESSION_H
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Metrics.h"
+#include "RenderScriptToolkit.h"
+#include "TaskProcessor.h"
+#include "Utils.h"
+
+#define LOG_TAG "renderscript.toolkit.Calibrate"
+
+namespace renderscript {
+
+namespace {
+
+// The calibration blurs an RGBA image of this size. It's large enough to be split in many
+// tiles, and small enough to keep the whole calibration quick.
+constexpr size_t kCalibrationSizeX = 512;
+constexpr size_t kCalibrationSizeY = 512;
+constexpr int kCalibrationRadius = 25;
+// Each configuration is timed twice and we keep the fastest run, which is the least disturbed
+// by the rest of the system.
+constexpr int kTimedRunsPerConfiguration = 2;
+// Additional threads are only kept if they reduce the time by at least 5%.
+constexpr double kRequiredThreadGain = 0.95;
+// The tile sizes tried once the number of threads is known.
+constexpr int kCandidateTileSizes[] = {4 * 1024, 8 * 1024, 16 * 1024, 32 * 1024, 64 * 1024};
+
+}  // namespace
+
+ThreadingConfiguration RenderScriptToolkit::calibrate() {
+    // The calibration blurs are not the app's.
+    ScopedMetricsSuppression suppression;
+    std::vector<uint8_t> in(kCalibrationSizeX * kCalibrationSizeY * 4);
+    std::vector<uint8_t> out(in.size());
+    // The blur skips most of the work in areas of a single color, so we time it on noise.
+    uint32_t seed = 1;
+    for (uint8_t& value : in) {
+        seed = seed * 1664525u + 1013904223u;
+        value = static_cast<uint8_t>(seed >> 24);
+    }
+
+    auto timeConfiguration = [&](const ThreadingConfiguration& configuration) {
+        setThreadingConfiguration(configuration);
+        double fastest = std::numeric_limits<double>::max();
+        for (int run = 0; run < kTimedRunsPerConfiguration; run++) {
+            const auto start = std::chrono::steady_clock::now();
+            blur(in.data(), out.data(), kCalibrationSizeX, kCalibrationSizeY, 4,
+                 kCalibrationRadius, nullptr);
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            fastest = std::min(fastest, elapsed.count());
+        }
+        return fastest;
+    };
+
+    // One untimed run with all the threads starts the pool threads that are not running yet,
+    // and warms the caches.
+    const int maxThreads = processor->getNumberOfThreads();
+    const int defaultTileSize = static_cast<int>(processor->getTargetTileSize());
+    setThreadingConfiguration(ThreadingConfiguration{maxThreads, defaultTileSize});
+    blur(in.data(), out.data(), kCalibrationSizeX, kCalibrationSizeY, 4, kCalibrationRadius,
+         nullptr);
+
+    // First find the number of threads with the default tile size, then the tile size for
+    // that number of threads. Trying all the combinations would take a lot longer for little
+    // benefit, as the two are mostly independent.
+    //
+    // The time drops with each thread until the cores or the memory bandwidth run out, then
+    // stays flat. Rather than trying every count, we double the count while it pays, then try
+    // the count halfway to the first one that didn't, e.g. 1, 2, 4, 8, then 6 on 8 cores.
+    ThreadingConfiguration best{1, defaultTileSize};
+    double bestTime = timeConfiguration(best);
+    auto tryThreadCount = [&](int threadCount) {
+        const ThreadingConfiguration candidate{threadCount, best.tileSizeInBytes};
+        const double time = timeConfiguration(candidate);
+        const bool better = time < bestTime * kRequiredThreadGain;
+        if (better) {
+            best = candidate;
+            bestTime = time;
+        }
+        return better;
+    };
+    int upper = maxThreads;
+    for (int threadCount = 2; threadCount < maxThreads * 2; threadCount *= 2) {
+        const int clamped = std::min(threadCount, maxThreads);
+        if (!tryThreadCount(clamped)) {
+            // The gain stopped somewhere below this count.
+            upper = clamped;
+            break;
+        }
+        if (clamped == maxThreads) {
+            break;
+        }
+    }
+    const int halfway = (best.threadCount + upper) / 2;
+    if (halfway > best.threadCount && halfway < upper) {
+        tryThreadCount(halfway);
+    }
+    for (int tileSize : kCandidateTileSizes) {
+        if (tileSize == best.tileSizeInBytes) {
+            continue;
+        }
+        const ThreadingConfiguration candidate{best.threadCount, tileSize};
+        const double time = timeConfiguration(candidate);
+        if (time < bestTime) {
+            best = candidate;
+            bestTime = time;
+        }
+    }
+    // Whether the four planes blurred by the single channel kernels beat the interleaved RGBA
+    // kernels depends on the SIMD units and the caches, so it's measured too.
+    ThreadingConfiguration planar = best;
+    planar.planarRgba = true;
+    if (timeConfiguration(planar) < bestTime) {
+        best = planar;
+    }
+
+    setThreadingConfiguration(best);
+    return best;
+}
+
+ThreadingConfiguration RenderScriptToolkit::getThreadingConfiguration() {
+    return ThreadingConfiguration{static_cast<int>(processor->getNumberOfActiveThreads()),
+                                  static_cast<int>(processor->getTargetTileSize()),
+                                  planarRgba.load()};
+}
+
+void RenderScriptToolkit::setThreadingConfiguration(const ThreadingConfiguration& configuration) {
+#ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
+    if (configuration.threadCount < 1) {
+        ALOGE("The threadCount should be at least 1. %d provided.", configuration.threadCount);
+        return;
+    }
+    if (configuration.tileSizeInBytes < 1) {
+        ALOGE("The tileSizeInBytes should be at least 1. %d provided.",
+              configuration.tileSizeInBytes);
+        return;
+    }
+#endif
+
+    processor->setConfiguration(std::max(1, configuration.threadCount),
+                                std::max(1, configuration.tileSizeInBytes));
+    planarRgba = configuration.planarRgba;
+}
+
+}  // namespace renderscript
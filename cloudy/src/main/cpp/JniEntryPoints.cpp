@@ -16,8 +16,14 @@
 
 #include <android/bitmap.h>
 #include <cassert>
+#include <cstring>
+#include <functional>
 #include <jni.h>
+#include <memory>
+#include <utility>
+#include <vector>
 
+#include "BlurSession.h"
 #include "RenderScriptToolkit.h"
 #include "Utils.h"
 
@@ -25,6 +31,10 @@
 
 using namespace renderscript;
 
+/* The natives are registered by JNI_OnLoad rather than looked up by their mangled names, which
+ * makes the first call of each cheaper and lets the symbols stay hidden.
+ */
+
 /**
  * I compared using env->GetPrimitiveArrayCritical vs. env->GetByteArrayElements to get access
  * to the underlying data. On Pixel 4, it's actually faster to not use critical. The code is left
@@ -164,7 +174,10 @@ public:
 };
 
 /**
- * Copies the content of Kotlin Range2d object into the equivalent C++ struct.
+ * Converts the restriction the Kotlin layer passes as four ints into the equivalent C++ struct.
+ *
+ * A null Range2d is passed as all zeros. As endX is always greater than startX for a valid
+ * restriction, an endX of 0 means there's no restriction.
  */
 class RestrictionParameter {
 private:
@@ -172,66 +185,421 @@ private:
     Restriction restriction;
 
 public:
-    RestrictionParameter(JNIEnv *env, jobject jRestriction) : isNull{jRestriction == nullptr} {
-        if (isNull) {
-            return;
-        }
-        /* TODO Measure how long FindClass and related functions take. Consider passing the
-         * four values instead. This would also require setting the default when Range2D is null.
-         */
-        jclass restrictionClass = env->FindClass("com/skydoves/cloudy/internals/render/Range2d");
-        if (restrictionClass == nullptr) {
-            ALOGE("RenderScriptToolit. Internal error. Could not find the Kotlin Range2d class.");
-            isNull = true;
-            return;
-        }
-        jfieldID startXId = env->GetFieldID(restrictionClass, "startX", "I");
-        jfieldID startYId = env->GetFieldID(restrictionClass, "startY", "I");
-        jfieldID endXId = env->GetFieldID(restrictionClass, "endX", "I");
-        jfieldID endYId = env->GetFieldID(restrictionClass, "endY", "I");
-        restriction.startX = env->GetIntField(jRestriction, startXId);
-        restriction.startY = env->GetIntField(jRestriction, startYId);
-        restriction.endX = env->GetIntField(jRestriction, endXId);
-        restriction.endY = env->GetIntField(jRestriction, endYId);
+    RestrictionParameter(jint startX, jint endX, jint startY, jint endY) : isNull{endX == 0} {
+        restriction.startX = startX;
+        restriction.endX = endX;
+        restriction.startY = startY;
+        restriction.endY = endY;
     }
 
     Restriction *get() { return isNull ? nullptr : &restriction; }
 };
 
-extern "C" JNIEXPORT jlong JNICALL
-Java_com_skydoves_cloudy_internals_render_RenderScriptToolkit_createNative(JNIEnv * /*env*/,
-                                                                              jobject /*thiz*/) {
+/**
+ * An image kept in native memory between calls, so that chained operations don't copy their
+ * intermediate images through the JVM heap. The Kotlin NativeImage class holds its pointer.
+ */
+struct NativeImage {
+    NativeImage(int width, int height, int vectorSize, bool premultiplied)
+        : buffer{static_cast<size_t>(width) * height * vectorSize},
+          width{width},
+          height{height},
+          vectorSize{vectorSize},
+          premultiplied{premultiplied} {}
+
+    LargeBuffer buffer;
+    int width;
+    int height;
+    int vectorSize;
+    bool premultiplied;
+};
+
+namespace {
+
+jlong createNative(JNIEnv * /*env*/, jobject /*thiz*/) {
     return reinterpret_cast<jlong>(new RenderScriptToolkit());
 }
 
-extern "C" JNIEXPORT void JNICALL
-Java_com_skydoves_cloudy_internals_render_RenderScriptToolkit_destroyNative(
+void destroyNative(
         JNIEnv * /*env*/, jobject /*thiz*/, jlong native_handle) {
     RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
     delete toolkit;
 }
 
-extern "C" JNIEXPORT void JNICALL
-Java_com_skydoves_cloudy_internals_render_RenderScriptToolkit_nativeBlur(
-        JNIEnv *env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array, jint vectorSize,
-        jint size_x, jint size_y, jint radius, jbyteArray output_array, jobject restriction) {
+jintArray nativeCalibrate(
+        JNIEnv *env, jobject /*thiz*/, jlong native_handle) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    ThreadingConfiguration configuration = toolkit->calibrate();
+
+    jint values[3] = {configuration.threadCount, configuration.tileSizeInBytes,
+                      configuration.planarRgba ? 1 : 0};
+    jintArray result = env->NewIntArray(3);
+    env->SetIntArrayRegion(result, 0, 3, values);
+    return result;
+}
+
+void nativeSetThreadingConfiguration(
+        JNIEnv * /*env*/, jobject /*thiz*/, jlong native_handle, jint thread_count,
+        jint tile_size_in_bytes, jboolean planar_rgba) {
     RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
-    RestrictionParameter restrict{env, restriction};
+    toolkit->setThreadingConfiguration(
+            ThreadingConfiguration{thread_count, tile_size_in_bytes, planar_rgba == JNI_TRUE});
+}
+
+jboolean nativeSetThermalThrottling(
+        JNIEnv * /*env*/, jobject /*thiz*/, jlong native_handle, jboolean enabled) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    std::shared_ptr<ThermalHeadroomSource> source =
+            enabled ? createAndroidThermalHeadroomSource() : nullptr;
+    const bool supported = !enabled || source != nullptr;
+    toolkit->setThermalHeadroomSource(std::move(source));
+    return supported;
+}
+
+jstring nativeDumpMetrics(
+        JNIEnv *env, jobject /*thiz*/) {
+    return env->NewStringUTF(dumpMetrics().c_str());
+}
+
+void nativeResetMetrics(
+        JNIEnv * /*env*/, jobject /*thiz*/) {
+    resetMetrics();
+}
+
+jstring nativeBenchmarkBlur(
+        JNIEnv *env, jobject /*thiz*/, jlong native_handle, jint iterations, jboolean counters) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    return env->NewStringUTF(toolkit->benchmarkBlur(iterations, counters).c_str());
+}
+
+void nativeBlur(JNIEnv *env, jobject /*thiz*/, jlong native_handle, jbyteArray input_array,
+                jint vectorSize, jint size_x, jint size_y, jint radius, jbyteArray output_array,
+                jint start_x, jint end_x, jint start_y, jint end_y) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    RestrictionParameter restrict{start_x, end_x, start_y, end_y};
     ByteArrayGuard input{env, input_array};
     ByteArrayGuard output{env, output_array};
 
     toolkit->blur(input.get(), output.get(), size_x, size_y, vectorSize, radius, restrict.get());
 }
 
-extern "C" JNIEXPORT void JNICALL
-Java_com_skydoves_cloudy_internals_render_RenderScriptToolkit_nativeBlurBitmap(
-        JNIEnv *env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
-        jobject output_bitmap, jint radius, jobject restriction) {
+jlong nativeCreateImage(JNIEnv *env, jobject /*thiz*/, jobject input_bitmap,
+                        jboolean premultiplied) {
+    BitmapGuard input{env, input_bitmap};
+    NativeImage *image = new NativeImage{input.width(), input.height(), input.vectorSize(),
+                                         premultiplied != JNI_FALSE};
+    memcpy(image->buffer.data(), input.get(), image->buffer.size());
+    return reinterpret_cast<jlong>(image);
+}
+
+void nativeDestroyImage(JNIEnv * /*env*/, jobject /*thiz*/, jlong image_handle) {
+    delete reinterpret_cast<NativeImage *>(image_handle);
+}
+
+void nativeCopyImageToBitmap(JNIEnv *env, jobject /*thiz*/, jlong image_handle,
+                             jobject output_bitmap) {
+    NativeImage *image = reinterpret_cast<NativeImage *>(image_handle);
+    BitmapGuard output{env, output_bitmap};
+    // The Kotlin layer creates the Bitmap with the size and config of the image.
+    memcpy(output.get(), image->buffer.data(), image->buffer.size());
+}
+
+jlong nativeBlurImage(JNIEnv * /*env*/, jobject /*thiz*/, jlong native_handle,
+                      jlong image_handle, jint radius) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    NativeImage *input = reinterpret_cast<NativeImage *>(image_handle);
+    NativeImage *output =
+            new NativeImage{input->width, input->height, input->vectorSize, input->premultiplied};
+
+    toolkit->blur(input->buffer.data(), output->buffer.data(), input->width, input->height,
+                  input->vectorSize, radius, nullptr,
+                  input->premultiplied ? AlphaMode::Premultiplied : AlphaMode::Unpremultiplied);
+    return reinterpret_cast<jlong>(output);
+}
+
+jlong nativeBlurAndDownscaleImage(JNIEnv * /*env*/, jobject /*thiz*/, jlong native_handle,
+                                  jlong image_handle, jint radius, jint output_width,
+                                  jint output_height) {
     RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
-    RestrictionParameter restrict{env, restriction};
+    NativeImage *input = reinterpret_cast<NativeImage *>(image_handle);
+    NativeImage *output =
+            new NativeImage{output_width, output_height, input->vectorSize, input->premultiplied};
+
+    toolkit->blurAndDownscale(
+            input->buffer.data(), output->buffer.data(), input->width, input->height,
+            input->vectorSize, output_width, output_height, radius,
+            input->premultiplied ? AlphaMode::Premultiplied : AlphaMode::Unpremultiplied);
+    return reinterpret_cast<jlong>(output);
+}
+
+/**
+ * Composites a color over each cell of a blurred session frame, with premultiplied alpha.
+ *
+ * @param argb The color, as an Android color int. Its channels are not premultiplied.
+ */
+void tintFrame(uint8_t *frame, size_t cellCount, size_t vectorSize, uint32_t argb) {
+    const uint32_t alpha = argb >> 24;
+    const uint32_t inverse = 255 - alpha;
+    // The tint in the byte order of the frame, premultiplied. ALPHA_8 frames only get its alpha.
+    uint8_t tint[4];
+    if (vectorSize == 1) {
+        tint[0] = static_cast<uint8_t>(alpha);
+    } else {
+        for (int c = 0; c < 3; c++) {
+            const uint32_t channel = (argb >> (16 - 8 * c)) & 0xff;
+            tint[c] = static_cast<uint8_t>((channel * alpha + 127) / 255);
+        }
+        tint[3] = static_cast<uint8_t>(alpha);
+    }
+    for (size_t i = 0; i < cellCount * vectorSize; i += vectorSize) {
+        for (size_t c = 0; c < vectorSize; c++) {
+            frame[i + c] = static_cast<uint8_t>(tint[c] + (frame[i + c] * inverse + 127) / 255);
+        }
+    }
+}
+
+jlong nativeCreateSession(JNIEnv * /*env*/, jobject /*thiz*/, jlong native_handle, jint width,
+                          jint height, jint vector_size, jint radius, jboolean premultiplied,
+                          jint tint_color) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    const size_t cellCount = static_cast<size_t>(width) * height;
+    const size_t vectorSize = static_cast<size_t>(vector_size);
+    const uint32_t tint = static_cast<uint32_t>(tint_color);
+    std::function<void(uint8_t *)> postProcess;
+    if ((tint >> 24) != 0) {
+        postProcess = [cellCount, vectorSize, tint](uint8_t *frame) {
+            tintFrame(frame, cellCount, vectorSize, tint);
+        };
+    }
+    return reinterpret_cast<jlong>(new BlurSession{
+            toolkit, static_cast<size_t>(width), static_cast<size_t>(height), vectorSize, radius,
+            premultiplied ? AlphaMode::Premultiplied : AlphaMode::Unpremultiplied,
+            std::move(postProcess)});
+}
+
+void nativeDestroySession(JNIEnv * /*env*/, jobject /*thiz*/, jlong session_handle) {
+    delete reinterpret_cast<BlurSession *>(session_handle);
+}
+
+void nativeSubmitSessionFrame(JNIEnv *env, jobject /*thiz*/, jlong session_handle,
+                              jobject input_bitmap) {
+    BlurSession *session = reinterpret_cast<BlurSession *>(session_handle);
+    BitmapGuard input{env, input_bitmap};
+    session->submitFrame(input.get());
+}
+
+jlong nativeAcquireSessionFrame(JNIEnv *env, jobject /*thiz*/, jlong session_handle,
+                                jobject output_bitmap) {
+    BlurSession *session = reinterpret_cast<BlurSession *>(session_handle);
+    uint64_t frameNumber;
+    const uint8_t *frame = session->acquireLatestFrame(&frameNumber);
+    if (frame == nullptr) {
+        return 0;
+    }
+    BitmapGuard output{env, output_bitmap};
+    memcpy(output.get(), frame,
+           static_cast<size_t>(output.width()) * output.height() * output.vectorSize());
+    return static_cast<jlong>(frameNumber);
+}
+
+jlong nativeGetSessionDroppedFrameCount(JNIEnv * /*env*/, jobject /*thiz*/,
+                                        jlong session_handle) {
+    BlurSession *session = reinterpret_cast<BlurSession *>(session_handle);
+    return static_cast<jlong>(session->getDroppedFrameCount());
+}
+
+void nativeBlurBitmap(JNIEnv *env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
+                      jobject output_bitmap, jint radius, jint start_x, jint end_x, jint start_y,
+                      jint end_y, jboolean premultiplied) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    RestrictionParameter restrict{start_x, end_x, start_y, end_y};
     BitmapGuard input{env, input_bitmap};
     BitmapGuard output{env, output_bitmap};
 
     toolkit->blur(input.get(), output.get(), input.width(), input.height(), input.vectorSize(),
-                  radius, restrict.get());
-}
\ No newline at end of file
+                  radius, restrict.get(),
+                  premultiplied ? AlphaMode::Premultiplied : AlphaMode::Unpremultiplied);
+}
+
+void nativeBlurPlanar(JNIEnv *env, jobject /*thiz*/, jlong native_handle,
+                      jobjectArray input_planes, jint size_x, jint size_y, jint radius,
+                      jobjectArray output_planes, jint start_x, jint end_x, jint start_y,
+                      jint end_y) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    RestrictionParameter restrict{start_x, end_x, start_y, end_y};
+    // The Kotlin layer validates that there are 1 to 4 planes on each side.
+    const jsize planeCount = env->GetArrayLength(input_planes);
+    std::unique_ptr<ByteArrayGuard> inputs[4];
+    std::unique_ptr<ByteArrayGuard> outputs[4];
+    const uint8_t *inputPlanes[4];
+    uint8_t *outputPlanes[4];
+    for (jsize i = 0; i < planeCount; i++) {
+        inputs[i].reset(new ByteArrayGuard{
+                env, static_cast<jbyteArray>(env->GetObjectArrayElement(input_planes, i))});
+        outputs[i].reset(new ByteArrayGuard{
+                env, static_cast<jbyteArray>(env->GetObjectArrayElement(output_planes, i))});
+        inputPlanes[i] = inputs[i]->get();
+        outputPlanes[i] = outputs[i]->get();
+    }
+
+    toolkit->blurPlanar(inputPlanes, outputPlanes, planeCount, size_x, size_y, radius,
+                        restrict.get());
+}
+
+void nativeBlurBitmapRegions(
+        JNIEnv *env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
+        jobject output_bitmap, jint radius, jintArray regions, jboolean premultiplied) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    BitmapGuard input{env, input_bitmap};
+    BitmapGuard output{env, output_bitmap};
+
+    // The regions are flattened by the Kotlin layer as startX, endX, startY, endY quadruplets.
+    IntArrayGuard values{env, regions};
+    const size_t regionCount = env->GetArrayLength(regions) / 4;
+    std::vector<Restriction> restrictions(regionCount);
+    for (size_t i = 0; i < regionCount; i++) {
+        const int *region = values.get() + i * 4;
+        restrictions[i] = Restriction{static_cast<size_t>(region[0]),
+                                      static_cast<size_t>(region[1]),
+                                      static_cast<size_t>(region[2]),
+                                      static_cast<size_t>(region[3])};
+    }
+
+    toolkit->blurRegions(input.get(), output.get(), input.width(), input.height(),
+                         input.vectorSize(), radius, restrictions.data(), regionCount,
+                         premultiplied ? AlphaMode::Premultiplied : AlphaMode::Unpremultiplied);
+}
+
+void nativeBlurBitmapScrolled(JNIEnv *env, jobject /*thiz*/, jlong native_handle,
+                              jobject input_bitmap, jobject output_bitmap, jint radius, jint dy,
+                              jboolean premultiplied) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    BitmapGuard input{env, input_bitmap};
+    BitmapGuard output{env, output_bitmap};
+
+    toolkit->blurScrolled(input.get(), output.get(), input.width(), input.height(),
+                          input.vectorSize(), radius, dy,
+                          premultiplied ? AlphaMode::Premultiplied : AlphaMode::Unpremultiplied);
+}
+
+void nativeBlurBitmapClipped(
+        JNIEnv *env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
+        jobject output_bitmap, jint radius, jfloat left, jfloat top, jfloat right,
+        jfloat bottom, jfloat corner_radius, jobject mask_bitmap, jboolean premultiplied) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    BitmapGuard input{env, input_bitmap};
+    BitmapGuard output{env, output_bitmap};
+    std::unique_ptr<BitmapGuard> mask;
+    if (mask_bitmap != nullptr) {
+        mask.reset(new BitmapGuard{env, mask_bitmap});
+    }
+    ClipShape clip{left, top, right, bottom, corner_radius, mask ? mask->get() : nullptr};
+
+    toolkit->blurClipped(input.get(), output.get(), input.width(), input.height(),
+                         input.vectorSize(), radius, clip, nullptr,
+                         premultiplied ? AlphaMode::Premultiplied : AlphaMode::Unpremultiplied);
+}
+
+void nativePrepareBlurWithinBudget(JNIEnv * /*env*/, jobject /*thiz*/, jlong native_handle) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    toolkit->prepareBlurWithinBudget();
+}
+
+jint nativeBlurBitmapWithinBudget(
+        JNIEnv *env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
+        jobject output_bitmap, jint radius, jlong budget_micros, jboolean premultiplied) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    BitmapGuard input{env, input_bitmap};
+    BitmapGuard output{env, output_bitmap};
+
+    BlurStrategy strategy = toolkit->blurWithinBudget(
+            input.get(), output.get(), input.width(), input.height(), input.vectorSize(), radius,
+            budget_micros,
+            premultiplied ? AlphaMode::Premultiplied : AlphaMode::Unpremultiplied);
+    return strategy.downscaleFactor;
+}
+
+void nativeBlurAndDownscaleBitmap(
+        JNIEnv *env, jobject /*thiz*/, jlong native_handle, jobject input_bitmap,
+        jobject output_bitmap, jint radius, jboolean premultiplied) {
+    RenderScriptToolkit *toolkit = reinterpret_cast<RenderScriptToolkit *>(native_handle);
+    BitmapGuard input{env, input_bitmap};
+    BitmapGuard output{env, output_bitmap};
+
+    toolkit->blurAndDownscale(input.get(), output.get(), input.width(), input.height(),
+                              input.vectorSize(), output.width(), output.height(), radius,
+                              premultiplied ? AlphaMode::Premultiplied
+                                            : AlphaMode::Unpremultiplied);
+}
+
+// The signatures must match the external functions of the Kotlin RenderScriptToolkit object.
+const JNINativeMethod kMethods[] = {
+        {"createNative", "()J", reinterpret_cast<void *>(createNative)},
+        {"destroyNative", "(J)V", reinterpret_cast<void *>(destroyNative)},
+        {"nativeCalibrate", "(J)[I", reinterpret_cast<void *>(nativeCalibrate)},
+        {"nativeSetThreadingConfiguration", "(JIIZ)V",
+         reinterpret_cast<void *>(nativeSetThreadingConfiguration)},
+        {"nativeSetThermalThrottling", "(JZ)Z",
+         reinterpret_cast<void *>(nativeSetThermalThrottling)},
+        {"nativeDumpMetrics", "()Ljava/lang/String;", reinterpret_cast<void *>(nativeDumpMetrics)},
+        {"nativeResetMetrics", "()V", reinterpret_cast<void *>(nativeResetMetrics)},
+        {"nativeBenchmarkBlur", "(JIZ)Ljava/lang/String;",
+         reinterpret_cast<void *>(nativeBenchmarkBlur)},
+        {"nativeCreateImage", "(Landroid/graphics/Bitmap;Z)J",
+         reinterpret_cast<void *>(nativeCreateImage)},
+        {"nativeDestroyImage", "(J)V", reinterpret_cast<void *>(nativeDestroyImage)},
+        {"nativeCopyImageToBitmap", "(JLandroid/graphics/Bitmap;)V",
+         reinterpret_cast<void *>(nativeCopyImageToBitmap)},
+        {"nativeBlurImage", "(JJI)J", reinterpret_cast<void *>(nativeBlurImage)},
+        {"nativeBlurAndDownscaleImage", "(JJIII)J",
+         reinterpret_cast<void *>(nativeBlurAndDownscaleImage)},
+        {"nativeCreateSession", "(JIIIIZI)J", reinterpret_cast<void *>(nativeCreateSession)},
+        {"nativeDestroySession", "(J)V", reinterpret_cast<void *>(nativeDestroySession)},
+        {"nativeSubmitSessionFrame", "(JLandroid/graphics/Bitmap;)V",
+         reinterpret_cast<void *>(nativeSubmitSessionFrame)},
+        {"nativeAcquireSessionFrame", "(JLandroid/graphics/Bitmap;)J",
+         reinterpret_cast<void *>(nativeAcquireSessionFrame)},
+        {"nativeGetSessionDroppedFrameCount", "(J)J",
+         reinterpret_cast<void *>(nativeGetSessionDroppedFrameCount)},
+        {"nativeBlur", "(J[BIIII[BIIII)V", reinterpret_cast<void *>(nativeBlur)},
+        {"nativeBlurBitmap", "(JLandroid/graphics/Bitmap;Landroid/graphics/Bitmap;IIIIIZ)V",
+         reinterpret_cast<void *>(nativeBlurBitmap)},
+        {"nativeBlurPlanar", "(J[[BIII[[BIIII)V", reinterpret_cast<void *>(nativeBlurPlanar)},
+        {"nativeBlurBitmapRegions", "(JLandroid/graphics/Bitmap;Landroid/graphics/Bitmap;I[IZ)V",
+         reinterpret_cast<void *>(nativeBlurBitmapRegions)},
+        {"nativeBlurBitmapScrolled", "(JLandroid/graphics/Bitmap;Landroid/graphics/Bitmap;IIZ)V",
+         reinterpret_cast<void *>(nativeBlurBitmapScrolled)},
+        {"nativeBlurBitmapClipped",
+         "(JLandroid/graphics/Bitmap;Landroid/graphics/Bitmap;IFFFFFLandroid/graphics/Bitmap;Z)V",
+         reinterpret_cast<void *>(nativeBlurBitmapClipped)},
+        {"nativePrepareBlurWithinBudget", "(J)V",
+         reinterpret_cast<void *>(nativePrepareBlurWithinBudget)},
+        {"nativeBlurBitmapWithinBudget",
+         "(JLandroid/graphics/Bitmap;Landroid/graphics/Bitmap;IJZ)I",
+         reinterpret_cast<void *>(nativeBlurBitmapWithinBudget)},
+        {"nativeBlurAndDownscaleBitmap", "(JLandroid/graphics/Bitmap;Landroid/graphics/Bitmap;IZ)V",
+         reinterpret_cast<void *>(nativeBlurAndDownscaleBitmap)},
+};
+
+}  // namespace
+
+extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void * /*reserved*/) {
+    JNIEnv *env;
+    if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+    jclass toolkitClass =
+            env->FindClass("com/skydoves/cloudy/internals/render/RenderScriptToolkit");
+    if (toolkitClass == nullptr) {
+        ALOGE("RenderScriptToolit. Internal error. Could not find the Kotlin toolkit class.");
+        return JNI_ERR;
+    }
+    const jint result = env->RegisterNatives(toolkitClass, kMethods,
+                                             sizeof(kMethods) / sizeof(kMethods[0]));
+    env->DeleteLocalRef(toolkitClass);
+    if (result != JNI_OK) {
+        ALOGE("RenderScriptToolit. Internal error. Could not register the natives.");
+        return JNI_ERR;
+    }
+    return JNI_VERSION_1_6;
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Metrics.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "RenderScriptToolkit.h"
+
+namespace renderscript {
+
+static const char* const kOpNames[kMetricsOpCount] = {
+        "blur",       "blurRegions", "blurClipped", "blurAndDownscale", "blurPlanar",
+        "blurScrolled",
+};
+
+static const char* const kKernelPathNames[kKernelPathCount] = {
+        "U4Asm", "U4Float", "U4Scalar", "U4EdgeRow", "U4Converted",
+        "U3",    "U1Asm",   "U1Float",  "U1Scalar",  "U1EdgeRow",
+        "Uniform",
+};
+
+const char* kernelPathName(KernelPath path) {
+    return kKernelPathNames[static_cast<size_t>(path)];
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency) {
+    uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    size_t bucket = 0;
+    while (micros > 1 && bucket + 1 < kBucketCount) {
+        micros >>= 1;
+        bucket++;
+    }
+    mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::quantileMicros(double quantile) const {
+    uint64_t counts[kBucketCount];
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        counts[i] = mBuckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    // The number of values at or below the quantile, rounded up.
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(quantile * total + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return uint64_t{2} << i;
+        }
+    }
+    return uint64_t{2} << (kBucketCount - 1);
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : mBuckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+MetricsRegistry& MetricsRegistry::get() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+thread_local int ScopedMetricsSuppression::sDepth = 0;
+
+void MetricsRegistry::recordCall(MetricsOp op, uint64_t pixels,
+                                 std::chrono::nanoseconds latency) {
+    if (ScopedMetricsSuppression::isActive()) {
+        return;
+    }
+    OpMetrics& metrics = mOps[static_cast<size_t>(op)];
+    metrics.calls.fetch_add(1, std::memory_order_relaxed);
+    metrics.pixels.fetch_add(pixels, std::memory_order_relaxed);
+    metrics.latency.record(latency);
+}
+
+void MetricsRegistry::recordQueueWait(std::chrono::nanoseconds wait) {
+    if (ScopedMetricsSuppression::isActive()) {
+        return;
+    }
+    mQueueWait.record(wait);
+}
+
+void MetricsRegistry::recordKernelRows(const uint64_t rows[kKernelPathCount]) {
+    if (ScopedMetricsSuppression::isActive()) {
+        return;
+    }
+    for (size_t i = 0; i < kKernelPathCount; i++) {
+        if (rows[i] != 0) {
+            mKernelRows[i].fetch_add(rows[i], std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t MetricsRegistry::getKernelRows(KernelPath path) const {
+    return mKernelRows[static_cast<size_t>(path)].load(std::memory_order_relaxed);
+}
+
+std::string MetricsRegistry::dump() const {
+    std::string text;
+    char line[256];
+    for (size_t i = 0; i < kMetricsOpCount; i++) {
+        const OpMetrics& metrics = mOps[i];
+        snprintf(line, sizeof(line),
+                 "%s calls=%llu megapixels=%.2f p50_us=%llu p99_us=%llu\n", kOpNames[i],
+                 (unsigned long long)metrics.calls.load(std::memory_order_relaxed),
+                 metrics.pixels.load(std::memory_order_relaxed) / 1e6,
+                 (unsigned long long)metrics.latency.quantileMicros(0.5),
+                 (unsigned long long)metrics.latency.quantileMicros(0.99));
+        text += line;
+    }
+    snprintf(line, sizeof(line), "queueWait p50_us=%llu p99_us=%llu\n",
+             (unsigned long long)mQueueWait.quantileMicros(0.5),
+             (unsigned long long)mQueueWait.quantileMicros(0.99));
+    text += line;
+    text += "kernelRows";
+    for (size_t i = 0; i < kKernelPathCount; i++) {
+        snprintf(line, sizeof(line), " %s=%llu", kKernelPathNames[i],
+                 (unsigned long long)mKernelRows[i].load(std::memory_order_relaxed));
+        text += line;
+    }
+    text += "\n";
+    const AllocationStats allocations = getAllocationStats();
+    snprintf(line, sizeof(line),
+             "allocations largeBuffers=%llu largeBufferBytes=%llu hugePageBuffers=%llu "
+             "hugePageBytes=%llu\n",
+             (unsigned long long)allocations.largeBufferCount,
+             (unsigned long long)allocations.largeBufferBytes,
+             (unsigned long long)allocations.hugePageBufferCount,
+             (unsigned long long)allocations.hugePageBytes);
+    text += line;
+    return text;
+}
+
+void MetricsRegistry::reset() {
+    for (OpMetrics& metrics : mOps) {
+        metrics.calls.store(0, std::memory_order_relaxed);
+        metrics.pixels.store(0, std::memory_order_relaxed);
+        metrics.latency.reset();
+    }
+    mQueueWait.reset();
+    for (auto& rows : mKernelRows) {
+        rows.store(0, std::memory_order_relaxed);
+    }
+}
+
+std::string dumpMetrics() {
+    return MetricsRegistry::get().dump();
+}
+
+void resetMetrics() {
+    MetricsRegistry::get().reset();
+}
+
+}  // namespace renderscript
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RENDERSCRIPT_TOOLKIT_METRICS_H
+#define ANDROID_RENDERSCRIPT_TOOLKIT_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace renderscript {
+
+/**
+ * The Toolkit operations we keep metrics for.
+ */
+enum class MetricsOp {
+    Blur,
+    BlurRegions,
+    BlurClipped,
+    BlurAndDownscale,
+    BlurPlanar,
+    BlurScrolled,
+    Count,
+};
+
+/**
+ * The code paths a row of a blur can take. The fast paths silently fall back to slower ones
+ * for narrow images, for the rows within the radius of the top and bottom edges, and when the
+ * CPU has no SIMD, so we count how many rows each path processed.
+ */
+enum class KernelPath {
+    // The whole row is done by the assembly kernel, on ARM.
+    U4Asm,
+    // The vertical pass is vectorized and the horizontal pass too on x86. This is what ARM
+    // falls back to for images narrower than 4 cells.
+    U4Float,
+    // Same as U4Float but without SIMD.
+    U4Scalar,
+    // A row within the radius of the top or bottom edge, whose vertical pass is done cell by
+    // cell to clamp at the edge.
+    U4EdgeRow,
+    // A row whose cells are premultiplied or decoded from sRGB as they're loaded. The
+    // horizontal pass of premultiplied rows is still vectorized on x86.
+    U4Converted,
+    U3,
+    U1Asm,
+    U1Float,
+    U1Scalar,
+    U1EdgeRow,
+    // A row of a tile whose neighborhood is a single color, copied from a row of the tile that
+    // the kernels blurred.
+    Uniform,
+    Count,
+};
+
+constexpr size_t kMetricsOpCount = static_cast<size_t>(MetricsOp::Count);
+constexpr size_t kKernelPathCount = static_cast<size_t>(KernelPath::Count);
+
+/**
+ * Returns the name of a kernel path, e.g. "U4Asm", as used by dumpMetrics() and benchmarkBlur().
+ */
+const char* kernelPathName(KernelPath path);
+
+/**
+ * A histogram of latencies with power of two buckets, from 1 microsecond to about an hour.
+ * Recording is lock free.
+ */
+class LatencyHistogram {
+    static constexpr size_t kBucketCount = 32;
+    // Bucket i counts the latencies in [2^i, 2^(i+1)) microseconds. Bucket 0 also counts the
+    // shorter ones, and the last bucket the longer ones.
+    std::atomic<uint64_t> mBuckets[kBucketCount] = {};
+
+   public:
+    void record(std::chrono::nanoseconds latency);
+
+    /**
+     * Returns the upper bound, in microseconds, of the bucket that contains the quantile,
+     * e.g. 0.99 for the p99. 0 if nothing was recorded.
+     */
+    uint64_t quantileMicros(double quantile) const;
+
+    void reset();
+};
+
+/**
+ * The process wide metrics of the Toolkit, shared by all the instances.
+ *
+ * Everything is counted with relaxed atomics, so that recording never blocks the work.
+ */
+class MetricsRegistry {
+    struct OpMetrics {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> pixels{0};
+        LatencyHistogram latency;
+    };
+    OpMetrics mOps[kMetricsOpCount];
+    // How long tasks waited for the tasks of other callers to complete.
+    LatencyHistogram mQueueWait;
+    std::atomic<uint64_t> mKernelRows[kKernelPathCount] = {};
+
+    MetricsRegistry() = default;
+
+   public:
+    static MetricsRegistry& get();
+
+    void recordCall(MetricsOp op, uint64_t pixels, std::chrono::nanoseconds latency);
+    void recordQueueWait(std::chrono::nanoseconds wait);
+    void recordKernelRows(const uint64_t rows[kKernelPathCount]);
+
+    /**
+     * Returns the number of rows processed by the path since the last reset().
+     */
+    uint64_t getKernelRows(KernelPath path) const;
+
+    /**
+     * Returns all the metrics as text, one line per metric.
+     */
+    std::string dump() const;
+
+    void reset();
+};
+
+/**
+ * Keeps the Toolkit calls made by the current thread out of the metrics while in scope, e.g.
+ * the blurs of a calibration, which would otherwise skew the latencies and kernel paths of the
+ * app's own calls. Scopes can be nested.
+ */
+class ScopedMetricsSuppression {
+    static thread_local int sDepth;
+
+   public:
+    ScopedMetricsSuppression() { sDepth++; }
+    ~ScopedMetricsSuppression() { sDepth--; }
+    ScopedMetricsSuppression(const ScopedMetricsSuppression&) = delete;
+    ScopedMetricsSuppression& operator=(const ScopedMetricsSuppression&) = delete;
+
+    static bool isActive() { return sDepth > 0; }
+};
+
+/**
+ * Records the latency of a Toolkit call from its construction to its destruction. Declare one
+ * at the top of each Toolkit method.
+ */
+class ScopedOpMetrics {
+    const MetricsOp mOp;
+    const uint64_t mPixels;
+    const std::chrono::steady_clock::time_point mStart;
+
+   public:
+    ScopedOpMetrics(MetricsOp op, uint64_t pixels)
+        : mOp{op}, mPixels{pixels}, mStart{std::chrono::steady_clock::now()} {}
+    ~ScopedOpMetrics() {
+        MetricsRegistry::get().recordCall(mOp, mPixels,
+                                          std::chrono::steady_clock::now() - mStart);
+    }
+};
+
+}  // namespace renderscript
+
+#endif  // ANDROID_RENDERSCRIPT_TOOLKIT_METRICS_H
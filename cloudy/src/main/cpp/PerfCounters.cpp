@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PerfCounters.h"
+
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "RenderScriptToolkit.h"
+#include "TaskProcessor.h"
+#include "Utils.h"
+
+#define LOG_TAG "renderscript.toolkit.PerfCounters"
+
+namespace renderscript {
+
+static int openCounter(pid_t threadId, uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // There's no libc wrapper for perf_event_open().
+    return syscall(__NR_perf_event_open, &attr, threadId, -1, -1, 0);
+}
+
+PerfCounters::PerfCounters(pid_t threadId) {
+    mFds[kCycles] = openCounter(threadId, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    mFds[kInstructions] = openCounter(threadId, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    mFds[kL1DataMisses] = openCounter(
+            threadId, PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    mFds[kLastLevelCacheMisses] =
+            openCounter(threadId, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    mFds[kStalledCycles] =
+            openCounter(threadId, PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND);
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : mFds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void PerfCounters::start() {
+    for (int fd : mFds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::stop() {
+    for (int fd : mFds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+}
+
+int64_t PerfCounters::read(PerfCounter counter) {
+    uint64_t value;
+    if (mFds[counter] < 0 || ::read(mFds[counter], &value, sizeof(value)) != sizeof(value)) {
+        return -1;
+    }
+    return value;
+}
+
+BlurProfile RenderScriptToolkit::profileBlur(const uint8_t* in, uint8_t* out, size_t sizeX,
+                                             size_t sizeY, size_t vectorSize, int radius,
+                                             const Restriction* restriction,
+                                             AlphaMode alphaMode, BlurSpace blurSpace) {
+    // Warm up, which also starts the pool threads so that we can attach counters to them.
+    blur(in, out, sizeX, sizeY, vectorSize, radius, restriction, alphaMode, blurSpace);
+
+    std::vector<std::unique_ptr<PerfCounters>> counters;
+    counters.push_back(std::make_unique<PerfCounters>(gettid()));
+    for (pid_t threadId : processor->getThreadIds()) {
+        counters.push_back(std::make_unique<PerfCounters>(threadId));
+    }
+
+    for (auto& threadCounters : counters) {
+        threadCounters->start();
+    }
+    const auto start = std::chrono::steady_clock::now();
+    blur(in, out, sizeX, sizeY, vectorSize, radius, restriction, alphaMode, blurSpace);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    for (auto& threadCounters : counters) {
+        threadCounters->stop();
+    }
+
+    // Sum the counters over the threads. A counter that's not available on one thread is
+    // not available on any.
+    int64_t totals[kPerfCounterCount];
+    for (int c = 0; c < kPerfCounterCount; c++) {
+        totals[c] = 0;
+        for (auto& threadCounters : counters) {
+            const int64_t value = threadCounters->read(static_cast<PerfCounter>(c));
+            if (value < 0) {
+                totals[c] = -1;
+                break;
+            }
+            totals[c] += value;
+        }
+    }
+
+    const size_t pixels = restriction == nullptr
+                                  ? sizeX * sizeY
+                                  : (restriction->endX - restriction->startX) *
+                                            (restriction->endY - restriction->startY);
+    // The size of a cache line on all the CPUs we run on.
+    const double cacheLineSize = 64.0;
+    BlurProfile profile;
+    profile.seconds = elapsed.count();
+    profile.cycles = totals[kCycles];
+    profile.instructions = totals[kInstructions];
+    profile.l1DataMisses = totals[kL1DataMisses];
+    profile.lastLevelCacheMisses = totals[kLastLevelCacheMisses];
+    profile.stalledCycles = totals[kStalledCycles];
+    profile.instructionsPerCycle = profile.cycles > 0 && profile.instructions >= 0
+                                           ? (double)profile.instructions / profile.cycles
+                                           : NAN;
+    profile.bytesPerPixel = profile.lastLevelCacheMisses >= 0
+                                    ? profile.lastLevelCacheMisses * cacheLineSize / pixels
+                                    : NAN;
+    if (profile.cycles < 0) {
+        ALOGW("The performance counters are not available. Only the wall time is measured.");
+    }
+    return profile;
+}
+
+}  // namespace renderscript
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RENDERSCRIPT_TOOLKIT_PERFCOUNTERS_H
+#define ANDROID_RENDERSCRIPT_TOOLKIT_PERFCOUNTERS_H
+
+#include <sys/types.h>
+
+#include <cstdint>
+
+namespace renderscript {
+
+/**
+ * The hardware events we count.
+ */
+enum PerfCounter {
+    kCycles,
+    kInstructions,
+    kL1DataMisses,
+    kLastLevelCacheMisses,
+    kStalledCycles,
+    kPerfCounterCount,
+};
+
+/**
+ * The performance counters of one thread, opened with perf_event_open().
+ *
+ * Each counter is opened on its own rather than as a group, as many CPUs don't support all of
+ * them and a group fails as a whole.
+ */
+class PerfCounters {
+    int mFds[kPerfCounterCount];
+
+   public:
+    /**
+     * Opens the counters of the thread. They don't count until start() is called.
+     */
+    explicit PerfCounters(pid_t threadId);
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    void start();
+    void stop();
+
+    /**
+     * Returns the value of the counter, or -1 if it could not be opened.
+     */
+    int64_t read(PerfCounter counter);
+};
+
+}  // namespace renderscript
+
+#endif  // ANDROID_RENDERSCRIPT_TOOLKIT_PERFCOUNTERS_H
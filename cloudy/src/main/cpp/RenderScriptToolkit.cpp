@@ -16,6 +16,10 @@
 
 #include "RenderScriptToolkit.h"
 
+#include <algorithm>
+#include <thread>
+
+#include "BlurBudget.h"
 #include "TaskProcessor.h"
 
 #define LOG_TAG "renderscript.toolkit.RenderScriptToolkit"
@@ -25,12 +29,32 @@ namespace renderscript {
 // You will find the implementation of the various transformations in the correspondingly
 // named source file. E.g. RenderScriptToolkit::blur() is found in Blur.cpp.
 
-RenderScriptToolkit::RenderScriptToolkit(int numberOfThreads)
-    : processor{new TaskProcessor(numberOfThreads)} {}
+RenderScriptToolkit::RenderScriptToolkit(int numberOfThreads, int idleTimeoutMillis)
+    : processor{new TaskProcessor(numberOfThreads, std::chrono::milliseconds(idleTimeoutMillis))},
+      costModel{new BlurCostModel()} {}
+
+RenderScriptToolkit::RenderScriptToolkit(std::shared_ptr<Executor> executor)
+    : processor{new TaskProcessor(std::move(executor))}, costModel{new BlurCostModel()} {}
 
 RenderScriptToolkit::~RenderScriptToolkit() {
     // By defining the destructor here, we don't need to include TaskProcessor.h
     // in RenderScriptToolkit.h.
 }
 
+void RenderScriptToolkit::setThermalHeadroomSource(
+        std::shared_ptr<ThermalHeadroomSource> source) {
+    processor->setThermalHeadroomSource(std::move(source));
+}
+
+bool RenderScriptToolkit::setNumaMode(bool enabled) {
+    return processor->setNumaMode(enabled);
+}
+
+std::shared_ptr<Executor> createThreadPoolExecutor(int numberOfThreads) {
+    const unsigned int threads = numberOfThreads > 0
+                                         ? numberOfThreads
+                                         : std::max(1u, std::thread::hardware_concurrency());
+    return std::make_shared<ThreadPoolExecutor>(threads);
+}
+
 }  // namespace renderscript
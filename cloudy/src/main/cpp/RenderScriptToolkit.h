@@ -17,12 +17,17 @@
 #ifndef ANDROID_RENDERSCRIPT_TOOLKIT_TOOLKIT_H
 #define ANDROID_RENDERSCRIPT_TOOLKIT_TOOLKIT_H
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
 
 namespace renderscript {
 
 class TaskProcessor;
+struct BlurCostModel;
 
 /**
  * Define a range of data to process.
@@ -42,6 +47,286 @@ struct Restriction {
     size_t endY;
 };
 
+/**
+ * How the color channels of RGBA cells relate to the alpha channel.
+ */
+enum class AlphaMode {
+    /**
+     * The color channels have been multiplied by alpha, e.g. Android Bitmaps. The cells are
+     * blurred as is.
+     */
+    Premultiplied,
+    /**
+     * The color channels are independent of alpha. The vertical pass premultiplies the cells
+     * in float as it loads them, and the blurred cells are unpremultiplied as they are
+     * written. This keeps the color of transparent cells from bleeding into their neighbors.
+     */
+    Unpremultiplied,
+};
+
+/**
+ * The space in which the color channels of RGBA cells are blurred.
+ */
+enum class BlurSpace {
+    /**
+     * The sRGB encoded values are blurred as is. This is the fastest, but mixing encoded
+     * values darkens the highlights.
+     */
+    Encoded,
+    /**
+     * The values are decoded to linear light before being blurred, and encoded back after.
+     * The conversions are table lookups done by the blur passes themselves.
+     *
+     * This is only available from C++; the Kotlin API always blurs the encoded values. It runs
+     * on a kernel written with vector extensions rather than the assembly kernels, and no bound
+     * on its cost is promised. benchmarkBlur() reports it as the "linear" mode, so its cost
+     * relative to Encoded can be checked on each device.
+     */
+    Linear,
+};
+
+/**
+ * Define a shape to clip the output of an operation to.
+ *
+ * The shape is either a rounded rectangle or, if mask is not null, a coverage mask. Cells
+ * partially covered by the shape are scaled by their coverage, which anti-aliases its edges.
+ *
+ * @property left The left edge of the rounded rectangle, in cells.
+ * @property top The top edge of the rounded rectangle, in cells.
+ * @property right The right edge of the rounded rectangle, in cells.
+ * @property bottom The bottom edge of the rounded rectangle, in cells.
+ * @property cornerRadius The radius of the corners, in cells. 0 for a plain rectangle.
+ *           A circle is a square with a corner radius of half its size.
+ * @property mask If not null, an A8 buffer of sizeX * sizeY bytes with the coverage of each
+ *           cell, from 0 to 255. The rounded rectangle is then ignored.
+ */
+struct ClipShape {
+    float left;
+    float top;
+    float right;
+    float bottom;
+    float cornerRadius;
+    const uint8_t* mask;
+};
+
+/**
+ * How the Toolkit distributes the work of a method call over its threads.
+ *
+ * @property threadCount The total number of threads that process the work, including the
+ *           thread that calls the method.
+ * @property tileSizeInBytes The target size of the tiles the work is split into. Smaller tiles
+ *           balance the load better, larger tiles cost less synchronization.
+ * @property planarRgba Whether premultiplied RGBA blurs deinterleave each tile into four planes
+ *           and blur them with the single channel kernels. calibrate() enables it on the
+ *           devices where that's faster than the four channel kernels.
+ */
+struct ThreadingConfiguration {
+    int threadCount;
+    int tileSizeInBytes;
+    bool planarRgba = false;
+};
+
+/**
+ * Runs the work of the Toolkit on threads owned by someone else.
+ *
+ * By default, each Toolkit owns a pool of threads. When the application has its own pool, the
+ * two compete for the cores. Implementing this interface lets the Toolkit run its work on the
+ * application's pool instead, and sharing one Executor between several Toolkits bounds the
+ * total number of threads. See createThreadPoolExecutor() for a native implementation.
+ */
+class Executor {
+public:
+    virtual ~Executor() {}
+
+    /**
+     * Returns the maximum number of jobs that can run at the same time, including the calling
+     * thread. The Toolkit never asks for more jobs per run() call.
+     */
+    virtual unsigned int getConcurrency() const = 0;
+
+    /**
+     * Calls job(0) to job(count - 1), possibly concurrently, and returns once they all have
+     * returned. Each job processes tiles of work until there's none left, so a job that
+     * starts late simply returns. Running job(0) on the calling thread is recommended, so that
+     * the work progresses even if the other threads are busy.
+     */
+    virtual void run(unsigned int count, const std::function<void(unsigned int)>& job) = 0;
+};
+
+/**
+ * Create a native pool of threads that several Toolkits can share.
+ *
+ * @param numberOfThreads The total number of threads, including the calling thread. If 0,
+ *        decided based on the number of cores.
+ */
+std::shared_ptr<Executor> createThreadPoolExecutor(int numberOfThreads = 0);
+
+/**
+ * The hardware performance counters of one blur, as measured by profileBlur().
+ *
+ * The counters cover the calling thread and the pool threads. A counter is -1 if the device
+ * does not provide it, or if the process isn't allowed to read it. On Android, reading them
+ * requires perf events to be enabled, e.g. with "adb shell setprop security.perf_harden 0".
+ *
+ * @property seconds The wall time of the blur.
+ * @property cycles The CPU cycles spent.
+ * @property instructions The instructions retired.
+ * @property l1DataMisses The L1 data cache read misses.
+ * @property lastLevelCacheMisses The last level cache misses.
+ * @property stalledCycles The cycles stalled in the back end, i.e. waiting for data or
+ *           execution units.
+ * @property instructionsPerCycle instructions / cycles. A low value with many last level
+ *           cache misses hints at a bandwidth bound kernel.
+ * @property bytesPerPixel The bytes read from memory, i.e. lastLevelCacheMisses times the cache
+ *           line size, per output pixel.
+ */
+struct BlurProfile {
+    double seconds;
+    int64_t cycles;
+    int64_t instructions;
+    int64_t l1DataMisses;
+    int64_t lastLevelCacheMisses;
+    int64_t stalledCycles;
+    double instructionsPerCycle;
+    double bytesPerPixel;
+};
+
+/**
+ * How blurWithinBudget() blurred an image.
+ *
+ * @property downscaleFactor 1 if the image was blurred at full resolution. Otherwise, the
+ *           image was downscaled by this factor, blurred, and upscaled back.
+ * @property blurSpace The space the image was blurred in.
+ * @property predictedMicros How long the cost model predicted the blur would take.
+ * @property measuredMicros How long the blur took.
+ */
+struct BlurStrategy {
+    int downscaleFactor;
+    BlurSpace blurSpace;
+    float predictedMicros;
+    float measuredMicros;
+};
+
+/**
+ * Counts the buffers the Toolkit allocated itself, e.g. for intermediate images, since the
+ * library was loaded.
+ *
+ * @property largeBufferCount The number of buffers allocated.
+ * @property largeBufferBytes The total size of those buffers.
+ * @property hugePageBufferCount How many of them the kernel accepted to back with transparent
+ *           huge pages. Only buffers of 2MB or more are candidates.
+ * @property hugePageBytes The total size of those buffers.
+ */
+struct AllocationStats {
+    uint64_t largeBufferCount;
+    uint64_t largeBufferBytes;
+    uint64_t hugePageBufferCount;
+    uint64_t hugePageBytes;
+};
+
+/**
+ * Returns the allocation counters, e.g. to confirm huge pages are used on a given kernel.
+ */
+AllocationStats getAllocationStats();
+
+/**
+ * Returns the runtime metrics of all the Toolkits of the process as text, one line per metric:
+ * for each operation, the number of calls, megapixels processed, and p50 and p99 latencies;
+ * how long calls waited for the calls of other threads; how many rows each kernel path
+ * processed, which shows how often the fast paths fall back to slower ones; and the
+ * allocations.
+ */
+std::string dumpMetrics();
+
+/**
+ * Resets the metrics returned by dumpMetrics(), except for the allocation counters.
+ */
+void resetMetrics();
+
+/**
+ * Reports how close the device is to thermal throttling.
+ *
+ * When a Toolkit has a source, it uses fewer threads as the headroom shrinks, and falls back
+ * to cheaper blur precision close to the limit. Sustained work, e.g. blurring an animated
+ * background, then heats the device less, which costs less than being throttled.
+ */
+class ThermalHeadroomSource {
+public:
+    virtual ~ThermalHeadroomSource() {}
+
+    /**
+     * Returns the thermal headroom, as defined by AThermal_getThermalHeadroom(): 0 when there's
+     * no thermal pressure, 1 when the device is about to be severely throttled, more beyond.
+     * Returns NaN if it's not known, in which case the previous value is kept.
+     *
+     * The Toolkit calls this at most once per second.
+     */
+    virtual float getHeadroom() = 0;
+};
+
+/**
+ * Create a source backed by the Android thermal API, forecasting the headroom
+ * forecastSeconds ahead. Returns null if the device does not support it, i.e. before
+ * Android 12.
+ */
+std::shared_ptr<ThermalHeadroomSource> createAndroidThermalHeadroomSource(
+        int forecastSeconds = 3);
+
+/**
+ * Create a source that reads the headroom from a text file containing a single float, e.g. a
+ * file written by a test or by a script that maps a Linux thermal zone to a headroom.
+ */
+std::shared_ptr<ThermalHeadroomSource> createFileThermalHeadroomSource(const char *_Nonnull path);
+
+/**
+ * An image buffer in an anonymous memory file, which another process can map.
+ *
+ * Sending fd() to another process, e.g. over a Unix domain socket or Binder, lets that process
+ * map the same pages with mapSharedImageBuffer(). A producer process can then hand its frames
+ * to a sandboxed process that blurs them without copying the pixels. The Toolkit functions take
+ * data() like any other buffer.
+ *
+ * The buffer is unmapped and its file descriptor closed on destruction. The pages are freed once
+ * every process has done the same.
+ */
+class SharedImageBuffer {
+public:
+    SharedImageBuffer(int fd, uint8_t *_Nonnull data, size_t size);
+    ~SharedImageBuffer();
+    SharedImageBuffer(const SharedImageBuffer &) = delete;
+    SharedImageBuffer &operator=(const SharedImageBuffer &) = delete;
+
+    /** The file descriptor to send to the other process. Owned by this buffer. */
+    int fd() const { return mFd; }
+    uint8_t *_Nonnull data() const { return mData; }
+    size_t size() const { return mSize; }
+
+private:
+    int mFd;
+    uint8_t *_Nonnull mData;
+    size_t mSize;
+};
+
+/**
+ * Create a buffer of size bytes in a new memory file, zero initialized.
+ *
+ * The file can't be shrunk, so the processes mapping it can't be made to fault by the others.
+ * Returns null if the kernel doesn't support memory files, i.e. before Linux 3.17.
+ *
+ * @param name The name of the file, only visible in /proc for debugging.
+ */
+std::unique_ptr<SharedImageBuffer> createSharedImageBuffer(
+        size_t size, const char *_Nonnull name = "renderscript-toolkit");
+
+/**
+ * Map a buffer from the file descriptor of a memory file received from another process.
+ *
+ * Takes ownership of fd, also on failure. Returns null if the file can't be mapped, or if it's
+ * smaller than size bytes or can still be shrunk, as the other process could then make this one
+ * fault by truncating it.
+ */
+std::unique_ptr<SharedImageBuffer> mapSharedImageBuffer(int fd, size_t size);
+
 /**
  * A collection of high-performance graphic utility functions like blur and blend.
  *
@@ -54,9 +339,12 @@ struct Restriction {
  * this will be 4.
  *
  * You should instantiate the Toolkit once and reuse it throughout your application.
- * On instantiation, the Toolkit creates a thread pool that's used for processing all the functions.
- * You can limit the number of pool threads used by the Toolkit via the constructor. The pool
- * threads are destroyed once the Toolkit is destroyed, after any pending work is done.
+ * The Toolkit uses a thread pool for processing all the functions. The pool threads are started
+ * by the first function call, so a Toolkit that's never used costs no thread. Pool threads that
+ * stay idle for a while exit, and are started again when there's more work. You can limit the
+ * number of pool threads used by the Toolkit, and how long they can stay idle, via the
+ * constructor. The pool threads are destroyed once the Toolkit is destroyed, after any pending
+ * work is done.
  *
  * This library is thread safe. You can call methods from different pool threads. The functions will
  * execute sequentially.
@@ -73,12 +361,43 @@ class RenderScriptToolkit {
      * tiles the tasks and schedule them over the pool threads.
      */
     std::unique_ptr<TaskProcessor> processor;
+    /** Predicts the cost of the strategies of blurWithinBudget(). Starts from pessimistic
+     * defaults until prepareBlurWithinBudget() calibrates it.
+     */
+    std::unique_ptr<BlurCostModel> costModel;
+    std::mutex costModelMutex;
+    /** Whether premultiplied RGBA blurs run through the single channel kernels. See
+     * ThreadingConfiguration::planarRgba.
+     */
+    std::atomic<bool> planarRgba{false};
+
+    /** Measures the costs of the blur strategies on this device. */
+    BlurCostModel calibrateCostModel();
+
+    /** Upscales an image with bilinear interpolation. Unpremultiplied cells are interpolated
+     * premultiplied.
+     */
+    void upscale(const uint8_t *_Nonnull in, uint8_t *_Nonnull out, size_t sizeX, size_t sizeY,
+                 size_t vectorSize, size_t outputSizeX, size_t outputSizeY,
+                 AlphaMode alphaMode = AlphaMode::Premultiplied);
 
 public:
     /**
-     * Creates the pool threads that are used for processing the method calls.
+     * Creates the pool that's used for processing the method calls. The pool threads are only
+     * started by the first method call.
+     *
+     * @param numberOfThreads The total number of threads to use. If 0, the Toolkit decides
+     * based on the number of cores.
+     * @param idleTimeoutMillis How long pool threads wait for work before exiting. They are
+     * started again when there's more work. If 0, they never exit.
      */
-    RenderScriptToolkit(int numberOfThreads = 0);
+    RenderScriptToolkit(int numberOfThreads = 0, int idleTimeoutMillis = 10000);
+
+    /**
+     * Creates a Toolkit that runs its work on the specified executor, rather than on a pool of
+     * threads of its own. The executor can be shared with other Toolkits.
+     */
+    explicit RenderScriptToolkit(std::shared_ptr<Executor> executor);
 
     /**
      * Destroys the thread pool. This stops any in-progress work; the Toolkit methods called from
@@ -88,6 +407,64 @@ public:
      */
     ~RenderScriptToolkit();
 
+    /**
+     * Measure the blur throughput of this device to find the best threading configuration.
+     *
+     * Blurs a synthetic 512x512 image with doubling numbers of threads, then with a few tile
+     * sizes for the best number of threads, then with the planar RGBA blur, and applies the
+     * fastest configuration. More threads are only kept if they are noticeably faster, as they
+     * also cost power. This runs about 21 radius 25 blurs of that image on 8 cores, so it should
+     * be done once, off the UI thread, and the result persisted and restored with
+     * setThreadingConfiguration().
+     *
+     * @return The configuration that has been applied.
+     */
+    ThreadingConfiguration calibrate();
+
+    /**
+     * Returns how the work is currently distributed over the threads.
+     */
+    ThreadingConfiguration getThreadingConfiguration();
+
+    /**
+     * Changes how the work is distributed over the threads, e.g. to restore the result of a
+     * previous calibrate().
+     *
+     * The thread count is clamped to the number of threads the Toolkit was created with or, if
+     * that was 0, to the number of cores.
+     */
+    void setThreadingConfiguration(const ThreadingConfiguration& configuration);
+
+    /**
+     * Adapts the number of threads and the blur precision to the thermal headroom of the device.
+     *
+     * Until the headroom reaches 0.75, the threading configuration is used as is. Up to 0.9,
+     * only half the threads are used. Up to 1, only two threads are used and linear light blurs
+     * are done as BlurSpace::Encoded. Beyond, the work is done on the calling thread only.
+     *
+     * @param source Where to read the headroom from. Null to stop adapting.
+     */
+    void setThermalHeadroomSource(std::shared_ptr<ThermalHeadroomSource> source);
+
+    /**
+     * Enables or disables NUMA mode, for multi-socket Linux machines.
+     *
+     * In NUMA mode, the pool threads are bound to the CPUs of a node, round robin. A thread that
+     * cannot be bound logs a warning and runs anywhere. The tiles of each task are split in one
+     * contiguous range per node, in node order, i.e. node k gets the k-th band of rows when the
+     * image is one tile wide, and the threads take the tiles of the node they run on first.
+     *
+     * The toolkit does not place memory. Linux puts a page on the node of the thread that
+     * first writes it, so the accesses to the input and output are only local if the caller
+     * first touched band k of each buffer from node k, e.g. by writing the output with a
+     * previous call of the same size in NUMA mode. Threads that run out of tiles take those of
+     * other nodes, so some accesses stay remote. Only the scratch memory of the threads is
+     * always local, as they allocate it on first use.
+     *
+     * @return Whether NUMA mode is enabled, i.e. false if the machine has a single node.
+     */
+    bool setNumaMode(bool enabled);
+
     /**
      * Blur an image.
      *
@@ -98,8 +475,9 @@ public:
      * take longer to compute. When the radius extends past the edge, the edge pixel will
      * be used as replacement for the pixel that's out off boundary.
      *
-     * Each input pixel can either be represented by four bytes (RGBA format) or one byte
-     * for the less common blurring of alpha channel only image.
+     * Each input pixel can either be represented by four bytes (RGBA format), three bytes
+     * (tightly packed RGB format, no padding), or one byte for the less common blurring of
+     * alpha channel only image.
      *
      * An optional range parameter can be set to restrict the operation to a rectangular subset
      * of each buffer. If provided, the range must be wholly contained with the dimensions
@@ -110,14 +488,246 @@ public:
      *
      * @param in The buffer of the image to be blurred.
      * @param out The buffer that receives the blurred image.
-     * @param sizeX The width of both buffers, as a number of 1 or 4 byte cells.
-     * @param sizeY The height of both buffers, as a number of 1 or 4 byte cells.
-     * @param vectorSize Either 1 or 4, the number of bytes in each cell, i.e. A vs. RGBA.
+     * @param sizeX The width of both buffers, as a number of 1, 3, or 4 byte cells.
+     * @param sizeY The height of both buffers, as a number of 1, 3, or 4 byte cells.
+     * @param vectorSize Either 1, 3, or 4, the number of bytes in each cell, i.e. A, RGB, or RGBA.
      * @param radius The radius of the pixels used to blur.
      * @param restriction When not null, restricts the operation to a 2D range of pixels.
      */
     void blur(const uint8_t *_Nonnull in, uint8_t *_Nonnull out, size_t sizeX, size_t sizeY,
               size_t vectorSize, int radius, const Restriction *_Nullable restriction = nullptr);
+
+    /**
+     * Blur an image and measure it with the hardware performance counters, e.g. to find out
+     * whether a kernel variant is compute or bandwidth bound for a given radius.
+     *
+     * Same parameters as blur(). The image is first blurred once without measuring, so that
+     * the pool threads are started and the caches are warm. Opening the counters is slow, so
+     * this is only meant for benchmarks.
+     */
+    BlurProfile profileBlur(const uint8_t *_Nonnull in, uint8_t *_Nonnull out, size_t sizeX,
+                            size_t sizeY, size_t vectorSize, int radius,
+                            const Restriction *_Nullable restriction = nullptr,
+                            AlphaMode alphaMode = AlphaMode::Premultiplied,
+                            BlurSpace blurSpace = BlurSpace::Encoded);
+
+    /**
+     * Benchmark blur() over a grid of radii (2, 8, 16, 25), sizes (512x512, 1080x1920), and
+     * vector sizes (1, 3, 4), and return the results as JSON. RGBA is measured in four modes:
+     * "premultiplied", "unpremultiplied" (AlphaMode::Unpremultiplied), "linear"
+     * (BlurSpace::Linear), and "planar" (ThreadingConfiguration::planarRgba).
+     *
+     * For each cell of the grid, the result has the parameters, the main kernel path taken,
+     * the median, mean, variance, min, and max throughput in megapixels per second, and the
+     * throughput of every iteration. The CPU model and the threading configuration are
+     * recorded too. The format is versioned by "schemaVersion", so that results can be compared
+     * across builds with scripts/compare-blur-benchmarks.py.
+     *
+     * This takes seconds, so it's only meant for benchmarks.
+     *
+     * @param iterations The number of measured blurs per cell. At least 2.
+     * @param counters Whether to also measure each cell with profileBlur() and add its
+     *        instructions per cycle, bytes read per pixel, and cache misses as "counters". A
+     *        counter the device doesn't provide is null.
+     */
+    std::string benchmarkBlur(int iterations = 10, bool counters = false);
+
+    /**
+     * Blur an image, specifying how its color channels relate to its alpha channel and in
+     * which space they are blurred.
+     *
+     * Same as the blur() above. When alphaMode is AlphaMode::Unpremultiplied, the cells are
+     * premultiplied as the blur loads them and unpremultiplied as it stores them, so callers
+     * don't need to convert the image themselves. When blurSpace is BlurSpace::Linear, the
+     * cells are decoded from and encoded back to sRGB by the blur passes. The alphaMode and
+     * blurSpace only apply to 4 byte cells.
+     *
+     * @param in The buffer of the image to be blurred.
+     * @param out The buffer that receives the blurred image.
+     * @param sizeX The width of both buffers, as a number of 1, 3, or 4 byte cells.
+     * @param sizeY The height of both buffers, as a number of 1, 3, or 4 byte cells.
+     * @param vectorSize Either 1, 3, or 4, the number of bytes in each cell, i.e. A, RGB, or RGBA.
+     * @param radius The radius of the pixels used to blur.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param alphaMode Whether the RGB channels of the cells are premultiplied by alpha.
+     * @param blurSpace Whether to blur the sRGB encoded values or the linear light values.
+     */
+    void blur(const uint8_t *_Nonnull in, uint8_t *_Nonnull out, size_t sizeX, size_t sizeY,
+              size_t vectorSize, int radius, const Restriction *_Nullable restriction,
+              AlphaMode alphaMode, BlurSpace blurSpace = BlurSpace::Encoded);
+
+    /**
+     * Blur several regions of an image.
+     *
+     * Same as blur() with a restriction, but blurs all the regions in a single call. The
+     * gaussian weights are computed once, and the tiles of all the regions are processed by
+     * a single dispatch to the thread pool. This is much cheaper than one call per region when
+     * blurring a few parts of the same image, e.g. a toolbar, a bottom sheet, and a dialog.
+     *
+     * Each region must be wholly contained with the dimensions described by sizeX and sizeY.
+     * The regions should not overlap, as the overlapping cells would be blurred more than
+     * once. Cells outside of all the regions are not modified.
+     *
+     * @param in The buffer of the image to be blurred.
+     * @param out The buffer that receives the blurred image.
+     * @param sizeX The width of both buffers, as a number of 1, 3, or 4 byte cells.
+     * @param sizeY The height of both buffers, as a number of 1, 3, or 4 byte cells.
+     * @param vectorSize Either 1, 3, or 4, the number of bytes in each cell, i.e. A, RGB, or RGBA.
+     * @param radius The radius of the pixels used to blur.
+     * @param regions The regionCount rectangles to blur.
+     * @param regionCount The number of regions.
+     * @param alphaMode Whether the RGB channels of the cells are premultiplied by alpha.
+     * @param blurSpace Whether to blur the sRGB encoded values or the linear light values.
+     */
+    void blurRegions(const uint8_t *_Nonnull in, uint8_t *_Nonnull out, size_t sizeX,
+                     size_t sizeY, size_t vectorSize, int radius,
+                     const Restriction *_Nonnull regions, size_t regionCount,
+                     AlphaMode alphaMode = AlphaMode::Premultiplied,
+                     BlurSpace blurSpace = BlurSpace::Encoded);
+
+    /**
+     * Update the blur of an image whose content scrolled vertically.
+     *
+     * When the content under a blurred header scrolls, most of the new blurred image is the
+     * previous one shifted. This shifts out in place, then blurs only the rows whose result
+     * changed: the band of newly exposed rows and the radius wide seam next to it, and the
+     * radius rows at the opposite edge, which clamp to a different row than before. A frame then
+     * costs O((|dy| + 2 * radius) * sizeX) instead of a full blur.
+     *
+     * out must hold the blur of the previous frame done with the same radius, alphaMode, and
+     * blurSpace. If the scroll is too large for the reuse to pay off, the whole image is blurred.
+     *
+     * @param in The new frame. Row y shows what row y + dy of the previous frame showed.
+     * @param out The blur of the previous frame, which receives the blur of the new one.
+     * @param dy How many rows the content moved up. Negative when it moved down.
+     */
+    void blurScrolled(const uint8_t *_Nonnull in, uint8_t *_Nonnull out, size_t sizeX,
+                      size_t sizeY, size_t vectorSize, int radius, int dy,
+                      AlphaMode alphaMode = AlphaMode::Premultiplied,
+                      BlurSpace blurSpace = BlurSpace::Encoded);
+
+    /**
+     * Blur an image, clipping the output to a shape.
+     *
+     * Same as blur(), but only the cells covered by the clip are blurred, e.g. the rounded
+     * corners of a card or a circular avatar. Each row is narrowed to the cells the clip
+     * covers, so cells that are never shown are not computed. The alpha of the cells partially
+     * covered by the clip is multiplied by their coverage, which gives anti-aliased edges. With
+     * AlphaMode::Premultiplied the color channels are multiplied too, so the result stays
+     * premultiplied; with AlphaMode::Unpremultiplied they are left as they are.
+     *
+     * Cells not covered by the clip are not modified, except cells within the holes of a
+     * mask, whose alpha is set to 0.
+     *
+     * The edges are faded through alpha, so RGB images, which have none, are not supported.
+     *
+     * @param in The buffer of the image to be blurred.
+     * @param out The buffer that receives the blurred image.
+     * @param sizeX The width of both buffers, as a number of 1 or 4 byte cells.
+     * @param sizeY The height of both buffers, as a number of 1 or 4 byte cells.
+     * @param vectorSize Either 1 or 4, the number of bytes in each cell, i.e. A or RGBA.
+     * @param radius The radius of the pixels used to blur.
+     * @param clip The shape to clip the output to.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     * @param alphaMode Whether the RGB channels of the cells are premultiplied by alpha.
+     * @param blurSpace Whether to blur the sRGB encoded values or the linear light values.
+     */
+    void blurClipped(const uint8_t *_Nonnull in, uint8_t *_Nonnull out, size_t sizeX,
+                     size_t sizeY, size_t vectorSize, int radius, const ClipShape &clip,
+                     const Restriction *_Nullable restriction = nullptr,
+                     AlphaMode alphaMode = AlphaMode::Premultiplied,
+                     BlurSpace blurSpace = BlurSpace::Encoded);
+
+    /**
+     * Blur an image and downscale the result.
+     *
+     * Produces the same image as blur() followed by a resize to outputSizeX by outputSizeY, at a
+     * fraction of the cost. Each output cell is first computed as the average of the input
+     * cells it covers, which prefilters the input to avoid aliasing. The remaining blur is then
+     * done at the output resolution. Computing a quarter size blurred image costs about as
+     * much as reading the input once plus a sixteenth of a full size blur.
+     *
+     * The blur at the output resolution is isotropic. When the two axes are downscaled by
+     * different factors, its radius is derived from the larger factor, so along the less
+     * downscaled axis the result is a bit less blurred than blur() followed by a resize.
+     *
+     * This is handy when only a small blurred thumbnail or a low resolution backdrop that the
+     * GPU will scale up is needed.
+     *
+     * @param in The buffer of the image to be blurred.
+     * @param out The buffer that receives the blurred image, outputSizeX * outputSizeY cells.
+     * @param sizeX The width of the input buffer, as a number of 1, 3, or 4 byte cells.
+     * @param sizeY The height of the input buffer, as a number of 1, 3, or 4 byte cells.
+     * @param vectorSize Either 1, 3, or 4, the number of bytes in each cell, i.e. A, RGB, or RGBA.
+     * @param outputSizeX The width of the output buffer. No larger than sizeX.
+     * @param outputSizeY The height of the output buffer. No larger than sizeY.
+     * @param radius The radius of the pixels used to blur, in input cells.
+     * @param alphaMode Whether the RGB channels of the cells are premultiplied by alpha.
+     *        Unpremultiplied cells are premultiplied as they're averaged, and the output is
+     *        unpremultiplied. Only applies to 4 byte cells.
+     */
+    void blurAndDownscale(const uint8_t *_Nonnull in, uint8_t *_Nonnull out, size_t sizeX,
+                          size_t sizeY, size_t vectorSize, size_t outputSizeX,
+                          size_t outputSizeY, int radius,
+                          AlphaMode alphaMode = AlphaMode::Premultiplied);
+
+    /**
+     * Blur an image as well as possible within a time budget.
+     *
+     * Same as blur() when the budget allows it. Otherwise, a cheaper strategy is used, in
+     * decreasing order of quality: a BlurSpace::Encoded rather than a BlurSpace::Linear blur,
+     * then blurAndDownscale() by a factor of 2, 4, or 8 followed by a bilinear upscale back to
+     * full size. If none fits, the cheapest one is used.
+     *
+     * The choice is based on a cost model, corrected by the measured time of every call. Until
+     * prepareBlurWithinBudget() calibrates it for the device, the model is a pessimistic
+     * default that tends to pick cheaper strategies than needed. This call never calibrates,
+     * so it's safe on the UI thread. 3 byte cells are modeled like 4 byte cells.
+     *
+     * @param budgetMicros How long the blur may take, in microseconds.
+     * @param alphaMode Whether the RGB channels of the cells are premultiplied by alpha. Every
+     *        strategy keeps unpremultiplied cells from bleeding, the downscaled ones included.
+     * @param blurSpace Whether to blur the sRGB encoded values or the linear light values.
+     * @return The strategy that was used.
+     */
+    BlurStrategy blurWithinBudget(const uint8_t *_Nonnull in, uint8_t *_Nonnull out,
+                                  size_t sizeX, size_t sizeY, size_t vectorSize, int radius,
+                                  int64_t budgetMicros,
+                                  AlphaMode alphaMode = AlphaMode::Premultiplied,
+                                  BlurSpace blurSpace = BlurSpace::Encoded);
+
+    /**
+     * Calibrate the cost model of blurWithinBudget() for this device.
+     *
+     * Runs 16 blurs, 4 downscales, and 4 upscales of a 512x512 image. This blocks for as long
+     * as they take, so call it off the UI thread, e.g. at startup. blurWithinBudget() can be called
+     * from other threads meanwhile; it uses the previous model until this returns. These blurs
+     * are not counted in the metrics.
+     */
+    void prepareBlurWithinBudget();
+
+    /**
+     * Blur an image stored as separate planes.
+     *
+     * Same as blur() but each channel of the image is stored in its own buffer of sizeX * sizeY
+     * bytes, e.g. one plane for R, one for G, one for B, and one for A. Each plane is blurred
+     * independently with the single channel kernels.
+     *
+     * The input and output planes must have the same dimensions. The buffers have a row-major
+     * layout.
+     *
+     * @param in The planeCount planes of the image to be blurred.
+     * @param out The planeCount planes that receive the blurred image.
+     * @param planeCount The number of planes, from 1 to 4.
+     * @param sizeX The width of all the planes.
+     * @param sizeY The height of all the planes.
+     * @param radius The radius of the pixels used to blur.
+     * @param restriction When not null, restricts the operation to a 2D range of pixels.
+     */
+    void blurPlanar(const uint8_t *_Nonnull const *_Nonnull in,
+                    uint8_t *_Nonnull const *_Nonnull out, size_t planeCount, size_t sizeX,
+                    size_t sizeY, int radius,
+                    const Restriction *_Nullable restriction = nullptr);
 };
 }  // namespace renderscript
 
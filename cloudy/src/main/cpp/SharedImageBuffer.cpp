@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "RenderScriptToolkit.h"
+#include "Utils.h"
+
+#define LOG_TAG "renderscript.toolkit.SharedImageBuffer"
+
+// Older NDK and libc headers don't have memfd_create or the seals, but the kernel may.
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_GET_SEALS 1034
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#endif
+
+namespace renderscript {
+
+namespace {
+
+// Maps size bytes of fd, shared. Closes fd on failure.
+std::unique_ptr<SharedImageBuffer> mapFd(int fd, size_t size) {
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        ALOGE("Could not map a shared image buffer of %zu bytes: %s", size, strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+    return std::make_unique<SharedImageBuffer>(fd, static_cast<uint8_t*>(data), size);
+}
+
+}  // namespace
+
+SharedImageBuffer::SharedImageBuffer(int fd, uint8_t* data, size_t size)
+    : mFd{fd}, mData{data}, mSize{size} {}
+
+SharedImageBuffer::~SharedImageBuffer() {
+    munmap(mData, mSize);
+    close(mFd);
+}
+
+std::unique_ptr<SharedImageBuffer> createSharedImageBuffer(size_t size, const char* name) {
+    if (size == 0) {
+        return nullptr;
+    }
+    // Bionic only has memfd_create from API 30, the syscall works on any Linux 3.17 or later.
+    const int fd = static_cast<int>(syscall(__NR_memfd_create, name,
+                                            MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (fd < 0) {
+        ALOGE("memfd_create failed: %s", strerror(errno));
+        return nullptr;
+    }
+    // The size is set once and for all, so that the receivers can trust it.
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0 ||
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) != 0) {
+        ALOGE("Could not size and seal a shared image buffer: %s", strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+    return mapFd(fd, size);
+}
+
+std::unique_ptr<SharedImageBuffer> mapSharedImageBuffer(int fd, size_t size) {
+    struct stat status;
+    if (size == 0 || fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < size) {
+        ALOGE("The shared image buffer is smaller than the %zu bytes expected.", size);
+        close(fd);
+        return nullptr;
+    }
+    const int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & F_SEAL_SHRINK) == 0) {
+        ALOGE("The shared image buffer can be shrunk by its sender.");
+        close(fd);
+        return nullptr;
+    }
+    return mapFd(fd, size);
+}
+
+}  // namespace renderscript
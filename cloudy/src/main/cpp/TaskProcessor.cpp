@@ -16,9 +16,17 @@
 
 #include "TaskProcessor.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
 #include <sys/prctl.h>
+#include <unistd.h>
 
+#include "Metrics.h"
 #include "RenderScriptToolkit.h"
 #include "Utils.h"
 
@@ -34,59 +42,69 @@ int Task::setTiling(unsigned int targetTileSizeInBytes) {
     const size_t targetCellsPerTile = targetTileSizeInBytes / cellSizeInBytes;
     assert(targetCellsPerTile > 0);
 
-    size_t cellsToProcessY;
-    size_t cellsToProcessX;
-    if (mRestriction == nullptr) {
-        cellsToProcessX = mSizeX;
-        cellsToProcessY = mSizeY;
+    mAreas.clear();
+    if (mRestrictions == nullptr) {
+        mAreas.push_back(TiledArea{0, 0, mSizeX, mSizeY, 0, 0, 0, 0, 0});
     } else {
-        assert(mRestriction->endX > mRestriction->startX);
-        assert(mRestriction->endY > mRestriction->startY);
-        cellsToProcessX = mRestriction->endX - mRestriction->startX;
-        cellsToProcessY = mRestriction->endY - mRestriction->startY;
+        for (size_t i = 0; i < mRestrictionCount; i++) {
+            const Restriction& restriction = mRestrictions[i];
+            assert(restriction.endX > restriction.startX);
+            assert(restriction.endY > restriction.startY);
+            mAreas.push_back(TiledArea{restriction.startX, restriction.startY, restriction.endX,
+                                       restriction.endY, 0, 0, 0, 0, 0});
+        }
+        std::sort(mAreas.begin(), mAreas.end(), [](const TiledArea& a, const TiledArea& b) {
+            return a.startY != b.startY ? a.startY < b.startY : a.startX < b.startX;
+        });
     }
 
-    // We want rows as large as possible, as the SIMD code we have is more efficient with
-    // large rows.
-    mTilesPerRow = divideRoundingUp(cellsToProcessX, targetCellsPerTile);
-    // Once we know the number of tiles per row, we divide that row evenly. We round up to make
-    // sure all cells are included in the last tile of the row.
-    mCellsPerTileX = divideRoundingUp(cellsToProcessX, mTilesPerRow);
+    size_t tileCount = 0;
+    for (TiledArea& area : mAreas) {
+        const size_t cellsToProcessX = area.endX - area.startX;
+        const size_t cellsToProcessY = area.endY - area.startY;
 
-    // We do the same thing for the Y direction.
-    size_t targetRowsPerTile = divideRoundingUp(targetCellsPerTile, mCellsPerTileX);
-    mTilesPerColumn = divideRoundingUp(cellsToProcessY, targetRowsPerTile);
-    mCellsPerTileY = divideRoundingUp(cellsToProcessY, mTilesPerColumn);
+        // We want rows as large as possible, as the SIMD code we have is more efficient with
+        // large rows.
+        area.tilesPerRow = divideRoundingUp(cellsToProcessX, targetCellsPerTile);
+        // Once we know the number of tiles per row, we divide that row evenly. We round up to
+        // make sure all cells are included in the last tile of the row.
+        area.cellsPerTileX = divideRoundingUp(cellsToProcessX, area.tilesPerRow);
 
-    return mTilesPerRow * mTilesPerColumn;
+        // We do the same thing for the Y direction.
+        size_t targetRowsPerTile = divideRoundingUp(targetCellsPerTile, area.cellsPerTileX);
+        area.tilesPerColumn = divideRoundingUp(cellsToProcessY, targetRowsPerTile);
+        area.cellsPerTileY = divideRoundingUp(cellsToProcessY, area.tilesPerColumn);
+
+        area.firstTile = tileCount;
+        tileCount += area.tilesPerRow * area.tilesPerColumn;
+    }
+    return tileCount;
 }
 
 void Task::processTile(unsigned int threadIndex, size_t tileIndex) {
-    // Figure out the overall boundaries.
-    size_t startWorkX;
-    size_t startWorkY;
-    size_t endWorkX;
-    size_t endWorkY;
-    if (mRestriction == nullptr) {
-        startWorkX = 0;
-        startWorkY = 0;
-        endWorkX = mSizeX;
-        endWorkY = mSizeY;
-    } else {
-        startWorkX = mRestriction->startX;
-        startWorkY = mRestriction->startY;
-        endWorkX = mRestriction->endX;
-        endWorkY = mRestriction->endY;
+    // Find the area this tile is part of. There's usually only one, and rarely more than a few.
+    size_t areaIndex = 0;
+    while (areaIndex + 1 < mAreas.size() && mAreas[areaIndex + 1].firstTile <= tileIndex) {
+        areaIndex++;
     }
+    const TiledArea& area = mAreas[areaIndex];
+    tileIndex -= area.firstTile;
+
     // Figure out the rectangle for this tileIndex. All our tiles form a 2D grid. Identify
     // first the X, Y coordinate of our tile in that grid.
-    size_t tileIndexY = tileIndex / mTilesPerRow;
-    size_t tileIndexX = tileIndex % mTilesPerRow;
+    // The tiles are numbered down each column of tiles, in serpentine order, i.e. every other
+    // column goes from the bottom to the top, so that consecutive tiles are always vertically
+    // adjacent and share the halo rows of the blur.
+    size_t tileIndexX = tileIndex / area.tilesPerColumn;
+    size_t tileIndexY = tileIndex % area.tilesPerColumn;
+    if (tileIndexX % 2 == 1) {
+        tileIndexY = area.tilesPerColumn - 1 - tileIndexY;
+    }
     // Calculate the starting and ending point of that tile.
-    size_t startCellX = startWorkX + tileIndexX * mCellsPerTileX;
-    size_t startCellY = startWorkY + tileIndexY * mCellsPerTileY;
-    size_t endCellX = std::min(startCellX + mCellsPerTileX, endWorkX);
-    size_t endCellY = std::min(startCellY + mCellsPerTileY, endWorkY);
+    size_t startCellX = area.startX + tileIndexX * area.cellsPerTileX;
+    size_t startCellY = area.startY + tileIndexY * area.cellsPerTileY;
+    size_t endCellX = std::min(startCellX + area.cellsPerTileX, area.endX);
+    size_t endCellY = std::min(startCellY + area.cellsPerTileY, area.endY);
 
     // Call the derived class to do the specific work.
     if (mPrefersDataAsOneRow && startCellX == 0 && endCellX == mSizeX) {
@@ -97,21 +115,214 @@ void Task::processTile(unsigned int threadIndex, size_t tileIndex) {
     }
 }
 
-TaskProcessor::TaskProcessor(unsigned int numThreads)
+TaskProcessor::TaskProcessor(unsigned int numThreads, std::chrono::milliseconds idleTimeout)
     : mUsesSimd{cpuSupportsSimd()},
       /* If the requested number of threads is 0, we'll decide based on the number of cores.
        * Through empirical testing, we've found that using more than 6 threads does not help.
        * There may be more optimal choices to make depending on the SoC but we'll stick to
-       * this simple heuristic for now.
+       * this simple heuristic for now. setConfiguration() can use up to one thread per core,
+       * e.g. when calibration finds that this device benefits from it.
        *
        * We'll re-use the thread that calls the processor doTask method, so we'll spawn one less
        * worker pool thread than the total number of threads.
        */
-      mNumberOfPoolThreads{numThreads ? numThreads - 1
-                                      : std::min(6u, std::thread::hardware_concurrency() - 1)} {
-    for (size_t i = 0; i < mNumberOfPoolThreads; i++) {
-        mPoolThreads.emplace_back(
-                std::bind(&TaskProcessor::processTilesOfWork, this, i + 1, false));
+      mMaxNumberOfPoolThreads{numThreads ? numThreads - 1
+                                         : std::max(1u, std::thread::hardware_concurrency()) - 1},
+      mNumberOfPoolThreads{numThreads ? numThreads - 1 : std::min(6u, mMaxNumberOfPoolThreads)},
+      mIdleTimeout{idleTimeout},
+      mPoolThreads(mMaxNumberOfPoolThreads),
+      mPoolThreadExited(mMaxNumberOfPoolThreads, true),
+      mPoolThreadIds(mMaxNumberOfPoolThreads, 0) {}
+
+TaskProcessor::TaskProcessor(std::shared_ptr<Executor> executor)
+    : mUsesSimd{cpuSupportsSimd()},
+      mMaxNumberOfPoolThreads{std::max(1u, executor->getConcurrency()) - 1},
+      // As for our own pool, more than 6 threads are unlikely to help by default.
+      mNumberOfPoolThreads{std::min(6u, mMaxNumberOfPoolThreads)},
+      mExecutor{std::move(executor)},
+      mIdleTimeout{0} {}
+
+void TaskProcessor::setConfiguration(unsigned int numThreads, unsigned int targetTileSizeInBytes) {
+    std::lock_guard<std::mutex> taskLock(mTaskMutex);
+    std::lock_guard<std::mutex> queueLock(mQueueMutex);
+    mNumberOfPoolThreads = std::clamp(numThreads, 1u, mMaxNumberOfPoolThreads + 1) - 1;
+    mTargetTileSize = targetTileSizeInBytes;
+}
+
+unsigned int TaskProcessor::getNumberOfActiveThreads() {
+    std::lock_guard<std::mutex> lock(mQueueMutex);
+    return mNumberOfPoolThreads + 1;
+}
+
+unsigned int TaskProcessor::getTargetTileSize() {
+    std::lock_guard<std::mutex> lock(mQueueMutex);
+    return mTargetTileSize;
+}
+
+void TaskProcessor::setThermalHeadroomSource(std::shared_ptr<ThermalHeadroomSource> source) {
+    std::lock_guard<std::mutex> lock(mTaskMutex);
+    mThermalSource = std::move(source);
+    mLastThermalQuery = {};
+    if (!mThermalSource) {
+        mThermalLevel = 0;
+    }
+}
+
+void TaskProcessor::updateThermalLevel() {
+    if (!mThermalSource) {
+        return;
+    }
+    // The headroom changes slowly, and the Android API returns NaN when called more than once
+    // per second.
+    const auto now = std::chrono::steady_clock::now();
+    if (mLastThermalQuery != std::chrono::steady_clock::time_point{} &&
+        now - mLastThermalQuery < std::chrono::seconds(1)) {
+        return;
+    }
+    mLastThermalQuery = now;
+    const float headroom = mThermalSource->getHeadroom();
+    if (std::isnan(headroom)) {
+        return;
+    }
+    mThermalLevel = headroom < 0.75f ? 0 : headroom < 0.9f ? 1 : headroom < 1.0f ? 2 : 3;
+}
+
+unsigned int TaskProcessor::getNumberOfWorkingPoolThreads() const {
+    switch (mThermalLevel.load(std::memory_order_relaxed)) {
+        case 0:
+            return mNumberOfPoolThreads;
+        case 1:
+            return mNumberOfPoolThreads / 2;
+        case 2:
+            return std::min(1u, mNumberOfPoolThreads);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Reads the CPUs of each NUMA node from sysfs, e.g. "0-7,16-23" for node 0. Returns no node if
+ * the kernel doesn't expose NUMA, as is the case on phones.
+ */
+static std::vector<std::vector<int>> readNumaNodeCpus() {
+    std::vector<std::vector<int>> nodeCpus;
+    for (int node = 0;; node++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE* file = fopen(path, "r");
+        if (file == nullptr) {
+            break;
+        }
+        std::vector<int> cpus;
+        int first;
+        while (fscanf(file, "%d", &first) == 1) {
+            int last = first;
+            int separator = fgetc(file);
+            if (separator == '-') {
+                if (fscanf(file, "%d", &last) != 1) {
+                    break;
+                }
+                separator = fgetc(file);
+            }
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+            if (separator != ',') {
+                break;
+            }
+        }
+        fclose(file);
+        nodeCpus.push_back(std::move(cpus));
+    }
+    return nodeCpus;
+}
+
+std::vector<pid_t> TaskProcessor::getThreadIds() {
+    std::lock_guard<std::mutex> lock(mQueueMutex);
+    std::vector<pid_t> ids;
+    for (pid_t id : mPoolThreadIds) {
+        if (id != 0) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+bool TaskProcessor::setNumaMode(bool enabled) {
+    std::lock_guard<std::mutex> taskLock(mTaskMutex);
+    std::lock_guard<std::mutex> queueLock(mQueueMutex);
+    if (enabled && mNodeCpus.empty()) {
+        mNodeCpus = readNumaNodeCpus();
+        for (size_t node = 0; node < mNodeCpus.size(); node++) {
+            for (int cpu : mNodeCpus[node]) {
+                if (cpu >= static_cast<int>(mCpuToNode.size())) {
+                    mCpuToNode.resize(cpu + 1, 0);
+                }
+                mCpuToNode[cpu] = node;
+            }
+        }
+    }
+    // Our own pool threads notice the change when they next wake up. The threads of an
+    // executor are not ours to bind, but they still take the tiles of their node first.
+    mNumaMode = enabled && mNodeCpus.size() > 1;
+    return mNumaMode;
+}
+
+void TaskProcessor::bindToNumaNode(int threadIndex, bool numaMode) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (size_t node = 0; node < mNodeCpus.size(); node++) {
+        // Spread the pool threads over the nodes, round robin.
+        if (!numaMode || node == (threadIndex - 1) % mNodeCpus.size()) {
+            for (int cpu : mNodeCpus[node]) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+    }
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        // The thread keeps its current affinity. In NUMA mode, it still takes the tiles of
+        // whichever node it runs on.
+        ALOGW("Could not %s pool thread %d: %s", numaMode ? "bind" : "unbind", threadIndex,
+              strerror(errno));
+    }
+}
+
+int TaskProcessor::takeTile(int threadIndex) {
+    mTilesNotYetStarted--;
+    size_t lane = threadIndex;
+    if (mNumaMode) {
+        // Take a tile of the node we're running on, so that the rows we read and write are
+        // local.
+        const int cpu = sched_getcpu();
+        lane = cpu >= 0 && cpu < static_cast<int>(mCpuToNode.size()) ? mCpuToNode[cpu] : 0;
+    }
+    if (lane < mLaneNextTile.size() && mLaneNextTile[lane] < mLaneEndTile[lane]) {
+        return mLaneNextTile[lane]++;
+    }
+    // Our range is done. Steal from the end of the range with the most left to do, so that
+    // its owner can keep walking it from the start.
+    size_t victim = 0;
+    for (size_t other = 1; other < mLaneNextTile.size(); other++) {
+        if (mLaneEndTile[other] - mLaneNextTile[other] >
+            mLaneEndTile[victim] - mLaneNextTile[victim]) {
+            victim = other;
+        }
+    }
+    return --mLaneEndTile[victim];
+}
+
+void TaskProcessor::startPoolThreads() {
+    std::lock_guard<std::mutex> lock(mQueueMutex);
+    for (size_t i = 0; i < getNumberOfWorkingPoolThreads(); i++) {
+        if (!mPoolThreadExited[i]) {
+            continue;
+        }
+        // The thread has exited, or was never started, so this does not block.
+        if (mPoolThreads[i].joinable()) {
+            mPoolThreads[i].join();
+        }
+        mPoolThreadExited[i] = false;
+        mPoolThreads[i] = std::thread(&TaskProcessor::processTilesOfWork, this, i + 1, false);
     }
 }
 
@@ -123,12 +334,14 @@ TaskProcessor::~TaskProcessor() {
     }
 
     for (auto& thread : mPoolThreads) {
-        thread.join();
+        if (thread.joinable()) {
+            thread.join();
+        }
     }
 }
 
 void TaskProcessor::processTilesOfWork(int threadIndex, bool returnWhenNoWork) {
-    if (threadIndex != 0) {
+    if (threadIndex != 0 && !mExecutor) {
         // Set the name of the thread, except for thread 0, which is not part of the pool.
         // PR_SET_NAME takes a maximum of 16 characters, including the terminating null.
         char name[16]{"RenderScToolkit"};
@@ -137,11 +350,31 @@ void TaskProcessor::processTilesOfWork(int threadIndex, bool returnWhenNoWork) {
     }
 
     std::unique_lock<std::mutex> lock(mQueueMutex);
+    if (threadIndex != 0 && !mExecutor) {
+        mPoolThreadIds[threadIndex - 1] = gettid();
+    }
+    bool boundToNode = false;
     while (true) {
-        mWorkAvailableOrStop.wait(lock, [this, returnWhenNoWork]() /*REQUIRES(mQueueMutex)*/ {
-            return mStopThreads || (mTilesNotYetStarted > 0) ||
+        // Pool threads beyond the configured number of threads, or beyond what the thermal
+        // state allows, don't take work. They'll exit once idle for mIdleTimeout.
+        auto workAvailableOrStop = [this, threadIndex,
+                                    returnWhenNoWork]() /*REQUIRES(mQueueMutex)*/ {
+            return mStopThreads ||
+                   (mTilesNotYetStarted > 0 &&
+                    static_cast<unsigned int>(threadIndex) <= getNumberOfWorkingPoolThreads()) ||
                    (returnWhenNoWork && (mTilesNotYetStarted == 0));
-        });
+        };
+        if (threadIndex != 0 && mIdleTimeout.count() > 0) {
+            if (!mWorkAvailableOrStop.wait_for(lock, mIdleTimeout, workAvailableOrStop)) {
+                // We've been idle for a while. Exit to release the thread and its stack. The
+                // next doTask() will start a new thread.
+                mPoolThreadExited[threadIndex - 1] = true;
+                mPoolThreadIds[threadIndex - 1] = 0;
+                break;
+            }
+        } else {
+            mWorkAvailableOrStop.wait(lock, workAvailableOrStop);
+        }
         // ALOGI("Woke thread%d", threadIndex);
 
         // This ScopedLockAssertion is to help the compiler when it checks thread annotations
@@ -152,10 +385,13 @@ void TaskProcessor::processTilesOfWork(int threadIndex, bool returnWhenNoWork) {
         if (mStopThreads || (returnWhenNoWork && mTilesNotYetStarted == 0)) {
             break;
         }
+        if (threadIndex != 0 && !mExecutor && boundToNode != mNumaMode) {
+            bindToNumaNode(threadIndex, mNumaMode);
+            boundToNode = mNumaMode;
+        }
 
         while (mTilesNotYetStarted > 0 && !mStopThreads) {
-            // This picks the tiles in decreasing order but that does not matter.
-            int myTile = --mTilesNotYetStarted;
+            int myTile = takeTile(threadIndex);
             mTilesInProcess++;
             lock.unlock();
             {
@@ -178,9 +414,27 @@ void TaskProcessor::processTilesOfWork(int threadIndex, bool returnWhenNoWork) {
 }
 
 void TaskProcessor::doTask(Task* task) {
+    const auto requested = std::chrono::steady_clock::now();
     std::lock_guard<std::mutex> lockGuard(mTaskMutex);
+    MetricsRegistry::get().recordQueueWait(std::chrono::steady_clock::now() - requested);
+    updateThermalLevel();
     task->setUsesSimd(mUsesSimd);
     mCurrentTask = task;
+    if (mExecutor) {
+        startWork(task);
+        // Each job processes tiles until there's none left, like our pool threads would.
+        unsigned int jobCount;
+        {
+            std::lock_guard<std::mutex> lock(mQueueMutex);
+            jobCount = getNumberOfWorkingPoolThreads() + 1;
+        }
+        mExecutor->run(jobCount, [this](unsigned int jobIndex) {
+            processTilesOfWork(static_cast<int>(jobIndex), true);
+        });
+        mCurrentTask = nullptr;
+        return;
+    }
+    startPoolThreads();
     // Notify the thread pool of available work.
     startWork(task);
     // Start processing some of the tiles on the calling thread.
@@ -192,17 +446,25 @@ void TaskProcessor::doTask(Task* task) {
 
 void TaskProcessor::startWork(Task* task) {
     /**
-     * The size in bytes that we're hoping each tile will be. If this value is too small,
-     * we'll spend too much time in synchronization. If it's too large, some cores may be
-     * idle while others still have a lot of work to do. Ideally, it would depend on the
-     * device we're running. 16k is the same value used by RenderScript and seems reasonable
-     * from ad-hoc tests.
+     * mTargetTileSize is the size in bytes that we're hoping each tile will be. If this value
+     * is too small, we'll spend too much time in synchronization. If it's too large, some
+     * cores may be idle while others still have a lot of work to do. Ideally, it would depend
+     * on the device we're running. By default, it's 16k, the same value used by RenderScript
+     * that seems reasonable from ad-hoc tests. Calibration can pick a better one.
      */
-    const size_t targetTileSize = 16 * 1024;
-
     std::lock_guard<std::mutex> lock(mQueueMutex);
     assert(mTilesInProcess == 0);
-    mTilesNotYetStarted = task->setTiling(targetTileSize);
+    mTilesNotYetStarted = task->setTiling(mTargetTileSize);
+    // Give each thread, or each node in NUMA mode, a contiguous range of tiles, i.e. a run of
+    // vertically adjacent tiles, which is a band of rows when the area is one tile wide.
+    const int laneCount =
+            mNumaMode ? mNodeCpus.size() : getNumberOfWorkingPoolThreads() + 1;
+    mLaneNextTile.clear();
+    mLaneEndTile.clear();
+    for (int lane = 0; lane < laneCount; lane++) {
+        mLaneNextTile.push_back(mTilesNotYetStarted * lane / laneCount);
+        mLaneEndTile.push_back(mTilesNotYetStarted * (lane + 1) / laneCount);
+    }
     mWorkAvailableOrStop.notify_all();
 }
 
@@ -216,4 +478,69 @@ void TaskProcessor::waitForPoolWorkersToComplete() {
     });
 }
 
+ThreadPoolExecutor::ThreadPoolExecutor(unsigned int numThreads) {
+    // The thread calling run() also runs jobs, so we need one less thread.
+    for (unsigned int i = 1; i < numThreads; i++) {
+        mThreads.emplace_back(&ThreadPoolExecutor::processJobs, this);
+    }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+        mJobAvailableOrStop.notify_all();
+    }
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void ThreadPoolExecutor::processJobs() {
+    char name[16]{"RenderScToolkit"};
+    prctl(PR_SET_NAME, name, 0, 0, 0);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mJobAvailableOrStop.wait(lock, [this]() /*REQUIRES(mMutex)*/ {
+            return mStop || !mJobs.empty();
+        });
+        if (mStop) {
+            break;
+        }
+        std::function<void()> job = std::move(mJobs.front());
+        mJobs.pop_front();
+        lock.unlock();
+        job();
+        lock.lock();
+    }
+}
+
+void ThreadPoolExecutor::run(unsigned int count, const std::function<void(unsigned int)>& job) {
+    if (count == 0) {
+        return;
+    }
+    // Other callers may be using the pool at the same time, so we track our own jobs.
+    std::mutex doneMutex;
+    std::condition_variable allDone;
+    unsigned int jobsRemaining = count - 1;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (unsigned int i = 1; i < count; i++) {
+            mJobs.emplace_back([&, i]() {
+                job(i);
+                std::lock_guard<std::mutex> doneLock(doneMutex);
+                if (--jobsRemaining == 0) {
+                    allDone.notify_one();
+                }
+            });
+        }
+        mJobAvailableOrStop.notify_all();
+    }
+    job(0);
+
+    std::unique_lock<std::mutex> doneLock(doneMutex);
+    allDone.wait(doneLock, [&jobsRemaining]() { return jobsRemaining == 0; });
+}
+
 }  // namespace renderscript
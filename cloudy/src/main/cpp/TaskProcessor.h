@@ -20,12 +20,20 @@
 // #include <android-base/thread_annotations.h>
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
 
+#include <sys/types.h>
+
+#include "RenderScriptToolkit.h"
+
 namespace renderscript {
 
 /**
@@ -75,46 +83,66 @@ class Task {
 
    private:
     /**
-     * If not null, we'll process a subset of the whole 2D array. This specifies the restriction.
+     * If not null, we'll process a subset of the whole 2D array. This specifies the
+     * restrictions, an array of mRestrictionCount rectangles.
      */
-    const struct Restriction* mRestriction;
+    const struct Restriction* mRestrictions;
+    const size_t mRestrictionCount;
 
     /**
      * We'll divide the work into rectangular tiles. See setTiling().
-     */
-
-    /**
-     * Size of a tile in the X direction, as a number of cells.
-     */
-    size_t mCellsPerTileX = 0;
-    /**
-     * Size of a tile in the Y direction, as a number of cells.
-     */
-    size_t mCellsPerTileY = 0;
-    /**
-     * Number of tiles per row of the restricted area we're working on.
-     */
-    size_t mTilesPerRow = 0;
-    /**
-     * Number of tiles per column of the restricted area we're working on.
-     */
-    size_t mTilesPerColumn = 0;
+     *
+     * Each area we're working on, i.e. the whole 2D array or each of the restrictions, is
+     * tiled separately. The tiles of all the areas are then numbered one after the other.
+     */
+    struct TiledArea {
+        /**
+         * The boundaries of the area. The end values are EXCLUDED.
+         */
+        size_t startX;
+        size_t startY;
+        size_t endX;
+        size_t endY;
+        /**
+         * Size of a tile in the X direction, as a number of cells.
+         */
+        size_t cellsPerTileX;
+        /**
+         * Size of a tile in the Y direction, as a number of cells.
+         */
+        size_t cellsPerTileY;
+        /**
+         * Number of tiles per row of the area.
+         */
+        size_t tilesPerRow;
+        /**
+         * Number of tiles per column of the area.
+         */
+        size_t tilesPerColumn;
+        /**
+         * The index of the first tile of this area.
+         */
+        size_t firstTile;
+    };
+    std::vector<TiledArea> mAreas;
 
    public:
     /**
      * Construct a task.
      *
      * sizeX and sizeY should be greater than 0. vectorSize should be between 1 and 4.
-     * The restriction should outlive this instance. The Toolkit validates the
+     * If restriction is not null, it points to restrictionCount rectangles to process.
+     * The restrictions should outlive this instance. The Toolkit validates the
      * arguments so we won't do that again here.
      */
     Task(size_t sizeX, size_t sizeY, size_t vectorSize, bool prefersDataAsOneRow,
-         const Restriction* restriction)
+         const Restriction* restriction, size_t restrictionCount = 1)
         : mSizeX{sizeX},
           mSizeY{sizeY},
           mVectorSize{vectorSize},
           mPrefersDataAsOneRow{prefersDataAsOneRow},
-          mRestriction{restriction} {}
+          mRestrictions{restriction},
+          mRestrictionCount{restriction == nullptr ? 0 : restrictionCount} {}
     virtual ~Task() {}
 
     void setUsesSimd(bool uses) { mUsesSimd = uses; }
@@ -128,6 +156,15 @@ class Task {
      * will want to process before checking for more work. If the target is set too low, we'll spend
      * more time in synchronization. If it's too large, some cores may not be used as efficiently.
      *
+     * Within an area, the tiles are numbered column by column, in serpentine order, so that
+     * tiles with consecutive numbers are vertically adjacent. The TaskProcessor hands out runs
+     * of consecutive tiles to each thread.
+     *
+     * When there are multiple restrictions, each one is tiled and all the tiles are returned as
+     * one set, so that all the areas are processed by a single dispatch. The areas are ordered
+     * from top to bottom, so that areas that are close to each other are processed one after
+     * the other and the rows they both read stay in the caches.
+     *
      * This method returns the number of tiles.
      *
      * @param targetTileSizeInBytes Target size. Values less than 1000 will be treated as 1000.
@@ -162,10 +199,56 @@ class TaskProcessor {
      */
     const bool mUsesSimd;
     /**
-     * The number of separate threads we'll spawn. It's one less than the number of threads that
-     * do the work as the client thread that starts the work will also be used.
+     * The number of separate threads we can spawn. It's one less than the number of threads that
+     * can do the work as the client thread that starts the work will also be used.
+     */
+    const unsigned int mMaxNumberOfPoolThreads;
+    /**
+     * The number of pool threads that currently take tiles of work, at most
+     * mMaxNumberOfPoolThreads. See setConfiguration().
+     */
+    unsigned int mNumberOfPoolThreads /*GUARDED_BY(mQueueMutex)*/;
+    /**
+     * The size in bytes that we're hoping each tile will be. See setConfiguration().
+     */
+    unsigned int mTargetTileSize /*GUARDED_BY(mQueueMutex)*/ = 16 * 1024;
+    /**
+     * If not null, the tiles are processed by jobs run on this executor rather than by our own
+     * pool threads, which are then never started.
+     */
+    const std::shared_ptr<Executor> mExecutor;
+    /**
+     * If not null, where to read the thermal headroom from. See updateThermalLevel().
+     */
+    std::shared_ptr<ThermalHeadroomSource> mThermalSource /*GUARDED_BY(mTaskMutex)*/;
+    /**
+     * When mThermalSource was last queried.
+     */
+    std::chrono::steady_clock::time_point mLastThermalQuery /*GUARDED_BY(mTaskMutex)*/;
+    /**
+     * How much we're throttling ourselves, from 0 (not at all) to 3 (calling thread only).
+     * Only changed between tasks.
+     */
+    std::atomic<int> mThermalLevel{0};
+    /**
+     * The CPUs of each NUMA node, and the node of each CPU. Read when NUMA mode is first
+     * enabled. See setNumaMode().
+     */
+    std::vector<std::vector<int>> mNodeCpus /*GUARDED_BY(mQueueMutex)*/;
+    std::vector<int> mCpuToNode /*GUARDED_BY(mQueueMutex)*/;
+    /**
+     * Whether pool threads are bound to NUMA nodes and take the tiles of their node first.
+     */
+    bool mNumaMode /*GUARDED_BY(mQueueMutex)*/ = false;
+    /**
+     * The tiles of the current task are split in contiguous ranges, one per thread or, in NUMA
+     * mode, one per node. Within an area, the tiles are numbered down each column of tiles, so
+     * consecutive tiles are vertically adjacent and a thread that walks its range finds the
+     * halo rows of each tile in its caches, as it just loaded them for the previous one. These
+     * are the next tile to start and the end of each range.
      */
-    const unsigned int mNumberOfPoolThreads;
+    std::vector<int> mLaneNextTile /*GUARDED_BY(mQueueMutex)*/;
+    std::vector<int> mLaneEndTile /*GUARDED_BY(mQueueMutex)*/;
     /**
      * Ensures that only one task is done at a time.
      */
@@ -175,9 +258,23 @@ class TaskProcessor {
      */
     std::mutex mQueueMutex;
     /**
-     * The thread pool workers.
+     * How long a pool thread waits for work before exiting. Zero to never exit.
+     */
+    const std::chrono::milliseconds mIdleTimeout;
+    /**
+     * The thread pool workers. They're started by the first doTask() call rather than by the
+     * constructor, so that a processor that's never used doesn't cost any thread.
+     */
+    std::vector<std::thread> mPoolThreads /*GUARDED_BY(mTaskMutex)*/;
+    /**
+     * For each pool thread, whether it has exited after being idle for mIdleTimeout. Exited
+     * threads are joined and restarted by the next doTask() call.
+     */
+    std::vector<bool> mPoolThreadExited /*GUARDED_BY(mQueueMutex)*/;
+    /**
+     * The kernel thread id of each running pool thread, 0 if not running. See getThreadIds().
      */
-    std::vector<std::thread> mPoolThreads;
+    std::vector<pid_t> mPoolThreadIds /*GUARDED_BY(mQueueMutex)*/;
     /**
      * The task being processed, if any. We only do one task at a time. We could create a queue
      * of tasks but using a mTaskMutex is sufficient for now.
@@ -217,6 +314,19 @@ class TaskProcessor {
      */
     void startWork(Task* task) /*REQUIRES(mTaskMutex)*/;
 
+    /**
+     * Picks the next tile for the thread to process and removes it from the tiles not yet
+     * started. That's the next tile of its range or, when its range is done, the last tile of
+     * the range with the most left to do.
+     */
+    int takeTile(int threadIndex) /*REQUIRES(mQueueMutex)*/;
+
+    /**
+     * Binds the calling pool thread to the CPUs of its NUMA node, or to all the CPUs if we're
+     * not in NUMA mode. If the system refuses, logs a warning and leaves the affinity as is.
+     */
+    void bindToNumaNode(int threadIndex, bool numaMode) /*REQUIRES(mQueueMutex)*/;
+
     /**
      * Tells the thread to start processing work off the queue.
      *
@@ -234,14 +344,44 @@ class TaskProcessor {
      */
     void waitForPoolWorkersToComplete();
 
+    /**
+     * Starts the pool threads that are not running, either because we haven't needed them yet
+     * or because they exited after being idle.
+     */
+    void startPoolThreads() /*REQUIRES(mTaskMutex)*/;
+
+    /**
+     * Queries mThermalSource, if it's time to, and updates mThermalLevel.
+     */
+    void updateThermalLevel() /*REQUIRES(mTaskMutex)*/;
+
+    /**
+     * The number of pool threads that take tiles of the current task, i.e. the configured number
+     * reduced according to mThermalLevel.
+     */
+    unsigned int getNumberOfWorkingPoolThreads() const /*REQUIRES(mQueueMutex)*/;
+
    public:
     /**
-     * Create the processor.
+     * How long pool threads wait for work before exiting, if not specified.
+     */
+    static constexpr std::chrono::milliseconds kDefaultIdleTimeout{10000};
+
+    /**
+     * Create the processor. No thread is started until the first task is done.
      *
      * @param numThreads The total number of threads to use. If 0, we'll decided based on system
-     * properties.
+     * properties, and setConfiguration() can later use up to one thread per core.
+     * @param idleTimeout How long pool threads wait for work before exiting, to release their
+     * resources. They are restarted when there's work again. Zero to keep them forever.
      */
-    explicit TaskProcessor(unsigned int numThreads = 0);
+    explicit TaskProcessor(unsigned int numThreads = 0,
+                           std::chrono::milliseconds idleTimeout = kDefaultIdleTimeout);
+
+    /**
+     * Create a processor that runs the tiles on the executor. It starts no thread of its own.
+     */
+    explicit TaskProcessor(std::shared_ptr<Executor> executor);
 
     ~TaskProcessor();
 
@@ -250,11 +390,93 @@ class TaskProcessor {
      */
     void doTask(Task* task);
 
+    /**
+     * Changes how the work is distributed, e.g. with values found by calibration.
+     *
+     * @param numThreads The total number of threads that take tiles of work. Clamped between
+     * 1 and getNumberOfThreads().
+     * @param targetTileSizeInBytes The target size of the tiles. See Task::setTiling().
+     */
+    void setConfiguration(unsigned int numThreads, unsigned int targetTileSizeInBytes);
+
+    /**
+     * Returns the total number of threads that currently take tiles of work.
+     */
+    unsigned int getNumberOfActiveThreads();
+
+    /**
+     * Returns the current target size of the tiles, in bytes.
+     */
+    unsigned int getTargetTileSize();
+
+    /**
+     * Sets where to read the thermal headroom from. Null to stop throttling.
+     */
+    void setThermalHeadroomSource(std::shared_ptr<ThermalHeadroomSource> source);
+
+    /**
+     * Returns how much the work is throttled, from 0 (not at all) to 3 (calling thread only).
+     * Tasks may pick cheaper algorithms from level 2.
+     */
+    int getThermalLevel() const { return mThermalLevel.load(std::memory_order_relaxed); }
+
+    /**
+     * Returns the kernel thread ids of the pool threads that are running, e.g. to attach
+     * performance counters to them. Empty when running on an Executor.
+     */
+    std::vector<pid_t> getThreadIds();
+
+    /**
+     * Enables or disables NUMA mode. See RenderScriptToolkit::setNumaMode().
+     *
+     * @return Whether the mode is enabled, i.e. false if there's a single node.
+     */
+    bool setNumaMode(bool enabled);
+
     /**
      * Some Tasks need to allocate temporary storage for each worker thread.
-     * This provides the number of threads.
+     * This provides the number of threads that may process tiles, whatever the configuration.
+     */
+    unsigned int getNumberOfThreads() const { return mMaxNumberOfPoolThreads + 1; }
+};
+
+/**
+ * The Executor returned by createThreadPoolExecutor(). Its threads run the jobs of all the
+ * run() calls in the order they were requested, so that concurrent callers share the threads.
+ */
+class ThreadPoolExecutor : public Executor {
+    std::vector<std::thread> mThreads;
+    /**
+     * Ensures consistent access to mJobs and mStop.
+     */
+    std::mutex mMutex;
+    /**
+     * Signaled when a job is queued or the threads need to shut down.
      */
-    unsigned int getNumberOfThreads() const { return mNumberOfPoolThreads + 1; }
+    std::condition_variable mJobAvailableOrStop;
+    /**
+     * The jobs not yet started, from all the run() calls in progress.
+     */
+    std::deque<std::function<void()>> mJobs /*GUARDED_BY(mMutex)*/;
+    /**
+     * Signals that the threads should terminate.
+     */
+    bool mStop /*GUARDED_BY(mMutex)*/ = false;
+
+    /**
+     * Runs the queued jobs until mStop is set.
+     */
+    void processJobs();
+
+   public:
+    /**
+     * @param numThreads The total number of threads, including the calling thread. At least 1.
+     */
+    explicit ThreadPoolExecutor(unsigned int numThreads);
+    ~ThreadPoolExecutor() override;
+
+    unsigned int getConcurrency() const override { return mThreads.size() + 1; }
+    void run(unsigned int count, const std::function<void(unsigned int)>& job) override;
 };
 
 }  // namespace renderscript
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dlfcn.h>
+#include <stdio.h>
+
+#include <cmath>
+#include <memory>
+#include <string>
+
+#include "RenderScriptToolkit.h"
+#include "Utils.h"
+
+#define LOG_TAG "renderscript.toolkit.ThermalHeadroom"
+
+namespace renderscript {
+
+namespace {
+
+// The thermal API is only available from Android 11, and the headroom from Android 12, while we
+// support older versions. We look the functions up at runtime rather than linking to them.
+struct AThermalManager;
+using AcquireManagerFunction = AThermalManager* (*)();
+using ReleaseManagerFunction = void (*)(AThermalManager*);
+using GetHeadroomFunction = float (*)(AThermalManager*, int);
+
+class AndroidThermalHeadroomSource : public ThermalHeadroomSource {
+    void* mLibrary;
+    ReleaseManagerFunction mRelease;
+    GetHeadroomFunction mGetHeadroom;
+    AThermalManager* mManager;
+    const int mForecastSeconds;
+
+   public:
+    AndroidThermalHeadroomSource(void* library, AcquireManagerFunction acquire,
+                                 ReleaseManagerFunction release, GetHeadroomFunction getHeadroom,
+                                 int forecastSeconds)
+        : mLibrary{library},
+          mRelease{release},
+          mGetHeadroom{getHeadroom},
+          mManager{acquire()},
+          mForecastSeconds{forecastSeconds} {}
+
+    ~AndroidThermalHeadroomSource() override {
+        if (mManager != nullptr) {
+            mRelease(mManager);
+        }
+        dlclose(mLibrary);
+    }
+
+    float getHeadroom() override {
+        return mManager == nullptr ? NAN : mGetHeadroom(mManager, mForecastSeconds);
+    }
+};
+
+class FileThermalHeadroomSource : public ThermalHeadroomSource {
+    const std::string mPath;
+
+   public:
+    explicit FileThermalHeadroomSource(const char* path) : mPath{path} {}
+
+    float getHeadroom() override {
+        FILE* file = fopen(mPath.c_str(), "r");
+        if (file == nullptr) {
+            return NAN;
+        }
+        float headroom;
+        const bool valid = fscanf(file, "%f", &headroom) == 1;
+        fclose(file);
+        return valid ? headroom : NAN;
+    }
+};
+
+}  // namespace
+
+std::shared_ptr<ThermalHeadroomSource> createAndroidThermalHeadroomSource(int forecastSeconds) {
+    void* library = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+    if (library == nullptr) {
+        return nullptr;
+    }
+    auto acquire = reinterpret_cast<AcquireManagerFunction>(
+            dlsym(library, "AThermal_acquireManager"));
+    auto release = reinterpret_cast<ReleaseManagerFunction>(
+            dlsym(library, "AThermal_releaseManager"));
+    auto getHeadroom = reinterpret_cast<GetHeadroomFunction>(
+            dlsym(library, "AThermal_getThermalHeadroom"));
+    if (acquire == nullptr || release == nullptr || getHeadroom == nullptr) {
+        ALOGW("The thermal headroom is not available on this device.");
+        dlclose(library);
+        return nullptr;
+    }
+    return std::make_shared<AndroidThermalHeadroomSource>(library, acquire, release, getHeadroom,
+                                                          forecastSeconds);
+}
+
+std::shared_ptr<ThermalHeadroomSource> createFileThermalHeadroomSource(const char* path) {
+    return std::make_shared<FileThermalHeadroomSource>(path);
+}
+
+}  // namespace renderscript
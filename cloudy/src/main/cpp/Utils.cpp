@@ -17,6 +17,10 @@
 #include "Utils.h"
 
 #include <cpu-features.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <atomic>
 
 #include "RenderScriptToolkit.h"
 
@@ -43,6 +47,50 @@ bool cpuSupportsSimd() {
     return false;
 }
 
+static std::atomic<uint64_t> largeBufferCount{0};
+static std::atomic<uint64_t> largeBufferBytes{0};
+static std::atomic<uint64_t> hugePageBufferCount{0};
+static std::atomic<uint64_t> hugePageBytes{0};
+
+LargeBuffer::LargeBuffer(size_t size) : mSize{size} {
+    largeBufferCount++;
+    largeBufferBytes += size;
+    if (size >= kHugePageSize) {
+        // Over-allocate so that we can start on a huge page boundary.
+        const size_t mappingSize = size + kHugePageSize;
+        void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping != MAP_FAILED) {
+            mMapping = mapping;
+            mMappingSize = mappingSize;
+            mData = reinterpret_cast<uint8_t*>(
+                    (reinterpret_cast<uintptr_t>(mapping) + kHugePageSize - 1) &
+                    ~(kHugePageSize - 1));
+            // This fails if the kernel is built without transparent huge pages, as on most
+            // phones. We then simply use regular pages.
+            if (madvise(mData, size, MADV_HUGEPAGE) == 0) {
+                hugePageBufferCount++;
+                hugePageBytes += size;
+            }
+            return;
+        }
+    }
+    mData = static_cast<uint8_t*>(malloc(size));
+}
+
+LargeBuffer::~LargeBuffer() {
+    if (mMapping != nullptr) {
+        munmap(mMapping, mMappingSize);
+    } else {
+        free(mData);
+    }
+}
+
+AllocationStats getAllocationStats() {
+    return AllocationStats{largeBufferCount.load(), largeBufferBytes.load(),
+                           hugePageBufferCount.load(), hugePageBytes.load()};
+}
+
 #ifdef ANDROID_RENDERSCRIPT_TOOLKIT_VALIDATE
 bool validRestriction(const char* tag, size_t sizeX, size_t sizeY, const Restriction* restriction) {
     if (restriction == nullptr) {
@@ -150,6 +150,34 @@ inline size_t paddedSize(size_t size) {
     return size == 3 ? 4 : size;
 }
 
+/**
+ * A buffer for the images the Toolkit allocates itself, e.g. intermediate images.
+ *
+ * Buffers of at least kHugePageSize bytes are mapped aligned to a huge page and advised to use
+ * transparent huge pages, which cuts the TLB misses of passes that stride over whole rows. If
+ * the kernel doesn't support them, or for smaller buffers, this is a plain allocation. The
+ * content is not initialized. See getAllocationStats().
+ */
+class LargeBuffer {
+   public:
+    static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+    explicit LargeBuffer(size_t size);
+    ~LargeBuffer();
+    LargeBuffer(const LargeBuffer&) = delete;
+    LargeBuffer& operator=(const LargeBuffer&) = delete;
+
+    uint8_t* data() const { return mData; }
+    size_t size() const { return mSize; }
+
+   private:
+    uint8_t* mData = nullptr;
+    size_t mSize;
+    // If not null, the mapping that contains mData. Otherwise mData was malloc'ed.
+    void* mMapping = nullptr;
+    size_t mMappingSize = 0;
+};
+
 }  // namespace renderscript
 
 #endif  // ANDROID_RENDERSCRIPT_TOOLKIT_UTILS_H
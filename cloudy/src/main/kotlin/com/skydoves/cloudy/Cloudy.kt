@@ -41,6 +41,7 @@ import androidx.compose.ui.platform.ComposeView
 import androidx.compose.ui.platform.LocalContext
 import androidx.compose.ui.platform.debugInspectorInfo
 import androidx.compose.ui.viewinterop.AndroidView
+import androidx.core.os.trace
 import androidx.core.view.doOnLayout
 import androidx.core.view.drawToBitmap
 import com.skydoves.cloudy.internals.CloudyModifier
@@ -55,6 +56,9 @@ import kotlin.coroutines.resume
 import kotlin.coroutines.resumeWithException
 import kotlin.coroutines.suspendCoroutine
 
+/** The trace section around each blur, as measured by the frame timing benchmark. */
+private const val blurTraceSection = "Cloudy#blur"
+
 /**
  * Cloudy is a replacement of the [blur] modifier (under Android 12),
  * which draws [content] blurred with the specified [radius].
@@ -197,10 +201,13 @@ private fun Modifier.cloudy(
               window = window
             )
 
-            blurredBitmap = RenderScriptToolkit.blur(
-              inputBitmap = targetBitmap,
-              radius = radius
-            )
+            // Traced so that benchmarks can tell the jank caused by the blur itself.
+            blurredBitmap = trace(blurTraceSection) {
+              RenderScriptToolkit.blur(
+                inputBitmap = targetBitmap,
+                radius = radius
+              )
+            }
           }
         }.invokeOnCompletion { throwable ->
           if (throwable == null) {
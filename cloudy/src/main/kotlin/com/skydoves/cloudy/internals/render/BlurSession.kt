@@ -0,0 +1,92 @@
+/*
+ * Designed and developed by 2022 skydoves (Jaewoong Eum)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.skydoves.cloudy.internals.render
+
+import android.graphics.Bitmap
+import java.io.Closeable
+
+/**
+ * Blurs a continuously updating backdrop, always keeping the freshest frame.
+ *
+ * Frames can be submitted from any thread with [submit], which only copies them and returns.
+ * A native thread blurs them one at a time, and drops a pending frame when a newer one arrives
+ * so that the blur never falls behind. [acquireLatest] copies the latest finished frame without
+ * waiting for a blur, e.g. on each draw.
+ *
+ * Create sessions with [RenderScriptToolkit.createBlurSession], and close them once done.
+ *
+ * @property width The width of the frames, in pixels.
+ * @property height The height of the frames, in pixels.
+ * @property config The config of the frames. ARGB_8888 or ALPHA_8.
+ */
+internal class BlurSession internal constructor(
+  private var handle: Long,
+  val width: Int,
+  val height: Int,
+  val config: Bitmap.Config
+) : Closeable {
+
+  /** How many submitted frames were replaced by a newer one before being blurred. */
+  val droppedFrameCount: Long
+    get() {
+      validateOpen("droppedFrameCount")
+      return RenderScriptToolkit.getSessionDroppedFrameCount(handle)
+    }
+
+  /**
+   * Submits a new source frame, replacing the pending one if its blur hasn't started.
+   *
+   * @param frame The frame, of the size and config of the session.
+   */
+  fun submit(frame: Bitmap) {
+    validateOpen("submit")
+    validateFrame("submit", frame)
+    RenderScriptToolkit.submitSessionFrame(handle, frame)
+  }
+
+  /**
+   * Copies the latest finished frame into [output].
+   *
+   * @param output A Bitmap of the size and config of the session.
+   * @return The number of the copied frame, counting the submitted frames from 1, or 0 if no
+   * frame has finished yet, in which case [output] is left unchanged.
+   */
+  fun acquireLatest(output: Bitmap): Long {
+    validateOpen("acquireLatest")
+    validateFrame("acquireLatest", output)
+    return RenderScriptToolkit.acquireSessionFrame(handle, output)
+  }
+
+  override fun close() {
+    if (handle != 0L) {
+      RenderScriptToolkit.destroySession(handle)
+      handle = 0L
+    }
+  }
+
+  private fun validateOpen(function: String) {
+    require(handle != 0L) {
+      "RenderScript Toolkit BlurSession.$function. The session has been closed."
+    }
+  }
+
+  private fun validateFrame(function: String, frame: Bitmap) {
+    validateBitmap("BlurSession.$function", frame)
+    require(frame.width == width && frame.height == height && frame.config == config) {
+      "RenderScript Toolkit BlurSession.$function. The frame should be a ${width}x$height " + "$config Bitmap. A ${frame.width}x${frame.height} ${frame.config} Bitmap provided."
+    }
+  }
+}
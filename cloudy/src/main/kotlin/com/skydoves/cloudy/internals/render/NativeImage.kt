@@ -0,0 +1,54 @@
+/*
+ * Designed and developed by 2022 skydoves (Jaewoong Eum)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.skydoves.cloudy.internals.render
+
+import android.graphics.Bitmap
+import java.io.Closeable
+
+/**
+ * An image that lives in the native memory of the [RenderScriptToolkit].
+ *
+ * The operations on native images take and return native images, so that an effect of several
+ * steps doesn't copy its intermediate images through the JVM heap. The pixels cross into a
+ * Bitmap only when [RenderScriptToolkit.toBitmap] is called.
+ *
+ * The memory of a native image isn't managed by the garbage collector, so it must be [close]d
+ * once it's no longer needed.
+ *
+ * @property width The width of the image, in pixels.
+ * @property height The height of the image, in pixels.
+ * @property config The config of the Bitmaps the image was created from and is copied into.
+ * @property isPremultiplied Whether the color channels are premultiplied by the alpha channel.
+ */
+internal class NativeImage internal constructor(
+  handle: Long,
+  val width: Int,
+  val height: Int,
+  val config: Bitmap.Config,
+  val isPremultiplied: Boolean
+) : Closeable {
+
+  /** The pointer to the native image, or 0 once closed. */
+  internal var handle: Long = handle
+    private set
+
+  override fun close() {
+    if (handle != 0L) {
+      RenderScriptToolkit.destroyNativeImage(handle)
+      handle = 0L
+    }
+  }
+}
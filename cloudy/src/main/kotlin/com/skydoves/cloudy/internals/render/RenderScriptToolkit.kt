@@ -18,6 +18,10 @@
 package com.skydoves.cloudy.internals.render
 
 import android.graphics.Bitmap
+import android.graphics.Color
+import android.graphics.RectF
+import com.skydoves.cloudy.BuildConfig
+import java.io.File
 
 // This string is used for error messages.
 private const val externalName = "RenderScript Toolkit"
@@ -33,8 +37,10 @@ private const val externalName = "RenderScript Toolkit"
  * For ByteArrays, you need to specify the width and height of the data to be processed, as
  * well as the number of bytes per pixel. For most use cases, this will be 4.
  *
- * The Toolkit creates a thread pool that's used for processing the functions. The threads live
- * for the duration of the application. They can be destroyed by calling the method shutdown().
+ * The Toolkit uses a thread pool for processing the functions. The threads are only started by
+ * the first function call, so merely loading the Toolkit at startup costs no thread. Threads
+ * that stay idle for a while exit, and are started again when there's more work. They can be
+ * destroyed by calling the method shutdown().
  *
  * This library is thread safe. You can call methods from different poolThreads. The functions will
  * execute sequentially.
@@ -59,8 +65,9 @@ public object RenderScriptToolkit {
    * take longer to compute. When the radius extends past the edge, the edge pixel will
    * be used as replacement for the pixel that's out off boundary.
    *
-   * Each input pixel can either be represented by four bytes (RGBA format) or one byte
-   * for the less common blurring of alpha channel only image.
+   * Each input pixel can either be represented by four bytes (RGBA format), three bytes
+   * (tightly packed RGB format, no padding), or one byte for the less common blurring of
+   * alpha channel only image.
    *
    * An optional range parameter can be set to restrict the operation to a rectangular subset
    * of each buffer. If provided, the range must be wholly contained with the dimensions
@@ -71,9 +78,9 @@ public object RenderScriptToolkit {
    * row-major layout.
    *
    * @param inputArray The buffer of the image to be blurred.
-   * @param vectorSize Either 1 or 4, the number of bytes in each cell, i.e. A vs. RGBA.
-   * @param sizeX The width of both buffers, as a number of 1 or 4 byte cells.
-   * @param sizeY The height of both buffers, as a number of 1 or 4 byte cells.
+   * @param vectorSize Either 1, 3, or 4, the number of bytes in each cell, i.e. A, RGB, or RGBA.
+   * @param sizeX The width of both buffers, as a number of 1, 3, or 4 byte cells.
+   * @param sizeY The height of both buffers, as a number of 1, 3, or 4 byte cells.
    * @param radius The radius of the pixels used to blur, a value from 1 to 25.
    * @param restriction When not null, restricts the operation to a 2D range of pixels.
    * @return The blurred pixels, a ByteArray of size.
@@ -87,8 +94,8 @@ public object RenderScriptToolkit {
     radius: Int = 5,
     restriction: Range2d? = null
   ): ByteArray {
-    require(vectorSize == 1 || vectorSize == 4) {
-      "$externalName blur. The vectorSize should be 1 or 4. $vectorSize provided."
+    require(vectorSize == 1 || vectorSize == 3 || vectorSize == 4) {
+      "$externalName blur. The vectorSize should be 1, 3, or 4. $vectorSize provided."
     }
     require(inputArray.size >= sizeX * sizeY * vectorSize) {
       "$externalName blur. inputArray is too small for the given dimensions. " + "$sizeX*$sizeY*$vectorSize < ${inputArray.size}."
@@ -107,11 +114,67 @@ public object RenderScriptToolkit {
       sizeY,
       radius,
       outputArray,
-      restriction
+      restriction?.startX ?: 0,
+      restriction?.endX ?: 0,
+      restriction?.startY ?: 0,
+      restriction?.endY ?: 0
     )
     return outputArray
   }
 
+  /**
+   * Blurs an image stored as separate planes.
+   *
+   * Performs a Gaussian blur of each plane and returns the results as new planes. This is the
+   * same as the ByteArray variant of [blur] but each channel of the image is stored in its own
+   * ByteArray, e.g. one plane for R, one for G, one for B, and one for A. This avoids having to
+   * interleave data that's already planar before blurring it.
+   *
+   * Each plane should be large enough for sizeX * sizeY bytes. It has a row-major layout.
+   *
+   * @param inputPlanes The 1 to 4 planes of the image to be blurred.
+   * @param sizeX The width of all the planes.
+   * @param sizeY The height of all the planes.
+   * @param radius The radius of the pixels used to blur, a value from 1 to 25.
+   * @param restriction When not null, restricts the operation to a 2D range of pixels.
+   * @return The blurred planes.
+   */
+  internal fun blurPlanar(
+    inputPlanes: Array<ByteArray>,
+    sizeX: Int,
+    sizeY: Int,
+    radius: Int = 5,
+    restriction: Range2d? = null
+  ): Array<ByteArray> {
+    require(inputPlanes.size in 1..4) {
+      "$externalName blurPlanar. The number of planes should be between 1 and 4. " + "${inputPlanes.size} provided."
+    }
+    inputPlanes.forEach { plane ->
+      require(plane.size >= sizeX * sizeY) {
+        "$externalName blurPlanar. A plane is too small for the given dimensions. " + "$sizeX*$sizeY < ${plane.size}."
+      }
+    }
+    require(radius in 1..25) {
+      "$externalName blurPlanar. The radius should be between 1 and 25. $radius provided."
+    }
+    validateRestriction("blurPlanar", sizeX, sizeY, restriction)
+
+    val outputPlanes = Array(inputPlanes.size) { ByteArray(inputPlanes[it].size) }
+    nativeBlurPlanar(
+      nativeHandle,
+      inputPlanes,
+      sizeX,
+      sizeY,
+      radius,
+      outputPlanes,
+      restriction?.startX ?: 0,
+      restriction?.endX ?: 0,
+      restriction?.startY ?: 0,
+      restriction?.endY ?: 0
+    )
+    return outputPlanes
+  }
+
   /**
    * Blurs an image.
    *
@@ -125,7 +188,9 @@ public object RenderScriptToolkit {
    *
    * This method supports input Bitmap of config ARGB_8888 and ALPHA_8. Bitmaps with a stride
    * different than width * vectorSize are not currently supported. The returned Bitmap has the
-   * same config.
+   * same config, and is premultiplied only if the input Bitmap is. Bitmaps that are not
+   * premultiplied are premultiplied while they're blurred, so that the color of transparent
+   * pixels does not bleed into their neighbors.
    *
    * An optional range parameter can be set to restrict the operation to a rectangular subset
    * of each buffer. If provided, the range must be wholly contained with the dimensions
@@ -150,10 +215,419 @@ public object RenderScriptToolkit {
     validateRestriction("blur", inputBitmap.width, inputBitmap.height, restriction)
 
     val outputBitmap = createCompatibleBitmap(inputBitmap)
-    nativeBlurBitmap(nativeHandle, inputBitmap, outputBitmap, radius, restriction)
+    nativeBlurBitmap(
+      nativeHandle,
+      inputBitmap,
+      outputBitmap,
+      radius,
+      restriction?.startX ?: 0,
+      restriction?.endX ?: 0,
+      restriction?.startY ?: 0,
+      restriction?.endY ?: 0,
+      inputBitmap.isPremultiplied
+    )
+    return outputBitmap
+  }
+
+  /**
+   * Blurs several regions of a Bitmap.
+   *
+   * Same as the Bitmap variant of [blur] with a restriction, but blurs all the regions in a
+   * single call. This is much cheaper than one call per region when blurring a few parts of the
+   * same Bitmap, e.g. a toolbar, a bottom sheet, and a dialog.
+   *
+   * Each region must be wholly contained with the dimensions of the Bitmap. The regions should
+   * not overlap. NOTE: The output Bitmap will still be full size, with the sections that are not
+   * blurred all set to 0.
+   *
+   * @param inputBitmap The buffer of the image to be blurred.
+   * @param radius The radius of the pixels used to blur, a value from 1 to 25.
+   * @param regions The regions to blur.
+   * @return The blurred Bitmap.
+   */
+  internal fun blur(
+    inputBitmap: Bitmap,
+    @androidx.annotation.IntRange(from = 1, to = 25) radius: Int,
+    regions: List<Range2d>
+  ): Bitmap {
+    validateBitmap("blur", inputBitmap)
+    require(radius in 1..25) {
+      "$externalName blur. The radius should be between 1 and 25. $radius provided."
+    }
+    regions.forEach { validateRestriction("blur", inputBitmap.width, inputBitmap.height, it) }
+
+    val flattenedRegions = IntArray(regions.size * 4)
+    regions.forEachIndexed { index, region ->
+      flattenedRegions[index * 4] = region.startX
+      flattenedRegions[index * 4 + 1] = region.endX
+      flattenedRegions[index * 4 + 2] = region.startY
+      flattenedRegions[index * 4 + 3] = region.endY
+    }
+    val outputBitmap = createCompatibleBitmap(inputBitmap)
+    nativeBlurBitmapRegions(
+      nativeHandle,
+      inputBitmap,
+      outputBitmap,
+      radius,
+      flattenedRegions,
+      inputBitmap.isPremultiplied
+    )
+    return outputBitmap
+  }
+
+  /**
+   * Blurs a Bitmap, clipping the result to a rounded rectangle or a coverage mask.
+   *
+   * Same as the Bitmap variant of [blur], but only the pixels covered by the clip are blurred,
+   * e.g. the rounded corners of a card or a circular avatar. Pixels that will never be shown are
+   * not computed. The alpha of pixels partially covered by the clip is multiplied by their
+   * coverage, which anti-aliases the edges. The color of premultiplied pixels is multiplied too.
+   * NOTE: The pixels that are not covered are all set to 0.
+   *
+   * @param inputBitmap The buffer of the image to be blurred.
+   * @param radius The radius of the pixels used to blur, a value from 1 to 25.
+   * @param clip The rounded rectangle to clip the result to, in pixels.
+   * @param cornerRadius The radius of the corners of [clip], in pixels.
+   * @param clipMask When not null, an ALPHA_8 Bitmap of the same size as [inputBitmap] with the
+   * coverage of each pixel. [clip] and [cornerRadius] are then ignored.
+   * @return The blurred Bitmap.
+   */
+  internal fun blurClipped(
+    inputBitmap: Bitmap,
+    @androidx.annotation.IntRange(from = 1, to = 25) radius: Int,
+    clip: RectF,
+    cornerRadius: Float = 0f,
+    clipMask: Bitmap? = null
+  ): Bitmap {
+    validateBitmap("blurClipped", inputBitmap)
+    require(radius in 1..25) {
+      "$externalName blurClipped. The radius should be between 1 and 25. $radius provided."
+    }
+    require(cornerRadius >= 0f) {
+      "$externalName blurClipped. The cornerRadius should not be negative. $cornerRadius provided."
+    }
+    if (clipMask != null) {
+      require(clipMask.config == Bitmap.Config.ALPHA_8) {
+        "$externalName blurClipped. The clipMask should be an ALPHA_8 Bitmap. " + "${clipMask.config} provided."
+      }
+      require(clipMask.width == inputBitmap.width && clipMask.height == inputBitmap.height) {
+        "$externalName blurClipped. The clipMask should have the same size as the inputBitmap."
+      }
+      validateBitmap("blurClipped", clipMask)
+    }
+
+    val outputBitmap = createCompatibleBitmap(inputBitmap)
+    nativeBlurBitmapClipped(
+      nativeHandle,
+      inputBitmap,
+      outputBitmap,
+      radius,
+      clip.left,
+      clip.top,
+      clip.right,
+      clip.bottom,
+      cornerRadius,
+      clipMask,
+      inputBitmap.isPremultiplied
+    )
+    return outputBitmap
+  }
+
+  /**
+   * Blurs a Bitmap as well as possible within a time budget, e.g. what's left of the frame.
+   *
+   * Blurs like the Bitmap variant of [blur] when the budget allows it. Otherwise, the Bitmap is
+   * blurred at half, a quarter, or an eighth of its resolution and scaled back up, whichever is
+   * the best that fits. The choice relies on a cost model that is corrected by every call. It
+   * starts from pessimistic defaults; call [prepareBlurWithinBudget] off the main thread to
+   * calibrate it for the device. This never calibrates, so it's safe on the main thread.
+   * Bitmaps that are not premultiplied don't bleed transparent colors, whichever the strategy.
+   *
+   * @param inputBitmap The buffer of the image to be blurred.
+   * @param radius The radius of the pixels used to blur, a value from 1 to 25.
+   * @param budgetMicros How long the blur may take, in microseconds.
+   * @return The blurred Bitmap, and the factor it was downscaled by to fit the budget.
+   */
+  internal fun blurWithinBudget(
+    inputBitmap: Bitmap,
+    @androidx.annotation.IntRange(from = 1, to = 25) radius: Int,
+    budgetMicros: Long
+  ): BudgetedBlur {
+    validateBitmap("blurWithinBudget", inputBitmap)
+    require(radius in 1..25) {
+      "$externalName blurWithinBudget. The radius should be between 1 and 25. $radius provided."
+    }
+    require(budgetMicros > 0) {
+      "$externalName blurWithinBudget. The budget should be positive. $budgetMicros provided."
+    }
+
+    val outputBitmap = createCompatibleBitmap(inputBitmap)
+    val downscaleFactor = nativeBlurBitmapWithinBudget(
+      nativeHandle,
+      inputBitmap,
+      outputBitmap,
+      radius,
+      budgetMicros,
+      inputBitmap.isPremultiplied
+    )
+    return BudgetedBlur(outputBitmap, downscaleFactor)
+  }
+
+  /**
+   * Calibrates the cost model of [blurWithinBudget] for this device.
+   *
+   * Runs 16 blurs, 4 downscales, and 4 upscales of a 512x512 image, so call it off the main
+   * thread, e.g. at startup. [blurWithinBudget] keeps using the previous model meanwhile. The
+   * calibration is not counted in [dumpMetrics].
+   */
+  internal fun prepareBlurWithinBudget() {
+    nativePrepareBlurWithinBudget(nativeHandle)
+  }
+
+  /**
+   * Updates the blur of a Bitmap whose content scrolled vertically.
+   *
+   * Most of the new blur is the previous one shifted, so this shifts [previousOutput] in place
+   * and only blurs the newly exposed rows and the seams next to them. This makes each frame of
+   * a scroll under a blurred header cost in proportion to [dy] rather than to the whole Bitmap.
+   *
+   * @param inputBitmap The new frame. Row y shows what row y + [dy] of the previous frame showed.
+   * @param previousOutput The blur of the previous frame with the same radius, which receives
+   * the blur of the new frame. Of the size and config of [inputBitmap].
+   * @param radius The radius of the pixels used to blur, a value from 1 to 25.
+   * @param dy How many rows the content moved up. Negative when it moved down.
+   */
+  internal fun blurScrolled(
+    inputBitmap: Bitmap,
+    previousOutput: Bitmap,
+    @androidx.annotation.IntRange(from = 1, to = 25) radius: Int,
+    dy: Int
+  ) {
+    validateBitmap("blurScrolled", inputBitmap)
+    require(radius in 1..25) {
+      "$externalName blurScrolled. The radius should be between 1 and 25. $radius provided."
+    }
+    require(
+      previousOutput.width == inputBitmap.width && previousOutput.height == inputBitmap.height &&
+        previousOutput.config == inputBitmap.config
+    ) {
+      "$externalName blurScrolled. previousOutput should have the size and config of " + "inputBitmap."
+    }
+    nativeBlurBitmapScrolled(
+      nativeHandle,
+      inputBitmap,
+      previousOutput,
+      radius,
+      dy,
+      inputBitmap.isPremultiplied
+    )
+  }
+
+  /**
+   * Blurs a Bitmap and downscales the result.
+   *
+   * Returns the same image as the Bitmap variant of [blur] followed by a resize to
+   * [outputWidth] by [outputHeight], at a fraction of the cost. Use this when only a small
+   * blurred thumbnail or a low resolution backdrop that will be scaled up is needed. When the
+   * width and the height are not downscaled by the same factor, the blur is as wide on both
+   * axes as on the more downscaled one, i.e. a bit narrower than [radius] along the other.
+   * Bitmaps that are not premultiplied are premultiplied as they're averaged and the result is
+   * not premultiplied either, so transparent pixels don't bleed into their neighbors.
+   *
+   * @param inputBitmap The buffer of the image to be blurred.
+   * @param outputWidth The width of the returned Bitmap. No larger than the input width.
+   * @param outputHeight The height of the returned Bitmap. No larger than the input height.
+   * @param radius The radius of the pixels used to blur, a value from 1 to 25, in input pixels.
+   * @return The blurred and downscaled Bitmap.
+   */
+  internal fun blurAndDownscale(
+    inputBitmap: Bitmap,
+    outputWidth: Int,
+    outputHeight: Int,
+    @androidx.annotation.IntRange(from = 1, to = 25) radius: Int
+  ): Bitmap {
+    validateBitmap("blurAndDownscale", inputBitmap)
+    require(radius in 1..25) {
+      "$externalName blurAndDownscale. The radius should be between 1 and 25. $radius provided."
+    }
+    require(outputWidth in 1..inputBitmap.width && outputHeight in 1..inputBitmap.height) {
+      "$externalName blurAndDownscale. The output size should be between 1x1 and the input " + "size ${inputBitmap.width}x${inputBitmap.height}. " + "${outputWidth}x$outputHeight provided."
+    }
+
+    val outputBitmap = createCompatibleBitmap(inputBitmap, outputWidth, outputHeight)
+    nativeBlurAndDownscaleBitmap(
+      nativeHandle,
+      inputBitmap,
+      outputBitmap,
+      radius,
+      inputBitmap.isPremultiplied
+    )
+    return outputBitmap
+  }
+
+  /**
+   * Copies a Bitmap into a [NativeImage], to chain operations on it without copying the
+   * intermediate images through the JVM heap.
+   *
+   * @param inputBitmap The image to copy. ARGB_8888 or ALPHA_8.
+   * @return The native image, to be closed once no longer needed.
+   */
+  internal fun createNativeImage(inputBitmap: Bitmap): NativeImage {
+    validateBitmap("createNativeImage", inputBitmap)
+    val premultiplied = inputBitmap.config == Bitmap.Config.ARGB_8888 && inputBitmap.isPremultiplied
+    return NativeImage(
+      nativeCreateImage(inputBitmap, premultiplied),
+      inputBitmap.width,
+      inputBitmap.height,
+      inputBitmap.config,
+      premultiplied
+    )
+  }
+
+  /**
+   * Blurs a [NativeImage].
+   *
+   * Same as the Bitmap variant of [blur], but the input and the result stay in native memory.
+   *
+   * @param image The image to be blurred. It's not closed.
+   * @param radius The radius of the pixels used to blur, a value from 1 to 25.
+   * @return The blurred image, to be closed once no longer needed.
+   */
+  internal fun blur(
+    image: NativeImage,
+    @androidx.annotation.IntRange(from = 1, to = 25) radius: Int
+  ): NativeImage {
+    validateNativeImage("blur", image)
+    require(radius in 1..25) {
+      "$externalName blur. The radius should be between 1 and 25. $radius provided."
+    }
+    return NativeImage(
+      nativeBlurImage(nativeHandle, image.handle, radius),
+      image.width,
+      image.height,
+      image.config,
+      image.isPremultiplied
+    )
+  }
+
+  /**
+   * Blurs a [NativeImage] and downscales the result.
+   *
+   * Same as the Bitmap variant of [blurAndDownscale], but the input and the result stay in
+   * native memory.
+   *
+   * @param image The image to be blurred. It's not closed.
+   * @param outputWidth The width of the result. No larger than the input width.
+   * @param outputHeight The height of the result. No larger than the input height.
+   * @param radius The radius of the pixels used to blur, a value from 1 to 25, in input pixels.
+   * @return The blurred and downscaled image, to be closed once no longer needed.
+   */
+  internal fun blurAndDownscale(
+    image: NativeImage,
+    outputWidth: Int,
+    outputHeight: Int,
+    @androidx.annotation.IntRange(from = 1, to = 25) radius: Int
+  ): NativeImage {
+    validateNativeImage("blurAndDownscale", image)
+    require(radius in 1..25) {
+      "$externalName blurAndDownscale. The radius should be between 1 and 25. $radius provided."
+    }
+    require(outputWidth in 1..image.width && outputHeight in 1..image.height) {
+      "$externalName blurAndDownscale. The output size should be between 1x1 and the input " + "size ${image.width}x${image.height}. " + "${outputWidth}x$outputHeight provided."
+    }
+    return NativeImage(
+      nativeBlurAndDownscaleImage(nativeHandle, image.handle, radius, outputWidth, outputHeight),
+      outputWidth,
+      outputHeight,
+      image.config,
+      image.isPremultiplied
+    )
+  }
+
+  /**
+   * Copies a [NativeImage] into a new Bitmap of the same size and config.
+   *
+   * @param image The image to copy. It's not closed.
+   * @return The Bitmap.
+   */
+  internal fun toBitmap(image: NativeImage): Bitmap {
+    validateNativeImage("toBitmap", image)
+    val outputBitmap = Bitmap.createBitmap(image.width, image.height, image.config)
+    if (image.config == Bitmap.Config.ARGB_8888) {
+      outputBitmap.isPremultiplied = image.isPremultiplied
+    }
+    nativeCopyImageToBitmap(image.handle, outputBitmap)
     return outputBitmap
   }
 
+  /** Frees the native memory of an image. Only for [NativeImage.close]. */
+  internal fun destroyNativeImage(imageHandle: Long) {
+    nativeDestroyImage(imageHandle)
+  }
+
+  /**
+   * Creates a [BlurSession] to blur a continuously updating backdrop.
+   *
+   * @param width The width of the frames, in pixels.
+   * @param height The height of the frames, in pixels.
+   * @param config The config of the frames. ARGB_8888 or ALPHA_8.
+   * @param radius The radius of the pixels used to blur, a value from 1 to 25.
+   * @param premultiplied Whether the color channels of the frames are premultiplied.
+   * @param tintColor A color composited over each blurred frame, e.g. to darken a backdrop
+   * behind text. It's done on a session thread of its own while the next frame is blurred.
+   * ALPHA_8 frames only take its alpha. Transparent by default, which leaves the frames
+   * untouched. Frames must be premultiplied to be tinted.
+   * @return The session, to be closed once no longer needed.
+   */
+  internal fun createBlurSession(
+    width: Int,
+    height: Int,
+    config: Bitmap.Config,
+    @androidx.annotation.IntRange(from = 1, to = 25) radius: Int,
+    premultiplied: Boolean = true,
+    @androidx.annotation.ColorInt tintColor: Int = Color.TRANSPARENT
+  ): BlurSession {
+    require(width > 0 && height > 0) {
+      "$externalName createBlurSession. The size should be at least 1x1. " + "${width}x$height provided."
+    }
+    require(config == Bitmap.Config.ARGB_8888 || config == Bitmap.Config.ALPHA_8) {
+      "$externalName. createBlurSession supports only ARGB_8888 and ALPHA_8 bitmaps. " + "$config provided."
+    }
+    require(radius in 1..25) {
+      "$externalName createBlurSession. The radius should be between 1 and 25. $radius provided."
+    }
+    require(premultiplied || Color.alpha(tintColor) == 0) {
+      "$externalName createBlurSession. Only premultiplied frames can be tinted."
+    }
+    val vectorSize = if (config == Bitmap.Config.ARGB_8888) 4 else 1
+    val sessionHandle =
+      nativeCreateSession(nativeHandle, width, height, vectorSize, radius, premultiplied, tintColor)
+    return BlurSession(
+      sessionHandle,
+      width,
+      height,
+      config
+    )
+  }
+
+  /** Frees a session. Only for [BlurSession.close]. */
+  internal fun destroySession(sessionHandle: Long) {
+    nativeDestroySession(sessionHandle)
+  }
+
+  /** Only for [BlurSession.submit]. */
+  internal fun submitSessionFrame(sessionHandle: Long, frame: Bitmap) {
+    nativeSubmitSessionFrame(sessionHandle, frame)
+  }
+
+  /** Only for [BlurSession.acquireLatest]. */
+  internal fun acquireSessionFrame(sessionHandle: Long, output: Bitmap): Long =
+    nativeAcquireSessionFrame(sessionHandle, output)
+
+  /** Only for [BlurSession.droppedFrameCount]. */
+  internal fun getSessionDroppedFrameCount(sessionHandle: Long): Long =
+    nativeGetSessionDroppedFrameCount(sessionHandle)
+
   /**
    * Identity matrix that can be passed to the {@link RenderScriptToolkit::colorMatrix} method.
    *
@@ -173,6 +647,96 @@ public object RenderScriptToolkit {
     nativeHandle = createNative()
   }
 
+  /**
+   * Find the threading configuration that blurs the fastest on this device and apply it.
+   *
+   * By default, the Toolkit uses up to 6 threads and 16KB tiles, which is not the best choice
+   * on every device. The calibration times radius 25 blurs of a 512x512 image with doubling
+   * numbers of threads, then with a few tile sizes, then with the RGBA channels blurred as
+   * separate planes, and keeps the fastest. That is about 21 blurs on 8 cores, so it should be
+   * done off the main thread, e.g. before the first blur.
+   *
+   * @param cacheFile If not null, the configuration is read from this file when it was
+   * written by the same version of the library on a device with as many CPUs, instead of
+   * calibrating again, and written to it after calibrating.
+   */
+  internal fun calibrate(cacheFile: File? = null) {
+    val cpuCount = Runtime.getRuntime().availableProcessors().toString()
+    val cached = cacheFile?.takeIf { it.exists() }?.let { file ->
+      runCatching { file.readText().trim().split(",") }.getOrNull()
+    }
+    if (cached != null && cached.size == 5 &&
+      cached[0] == BuildConfig.VERSION_NAME && cached[1] == cpuCount
+    ) {
+      val threadCount = cached[2].toIntOrNull() ?: 0
+      val tileSize = cached[3].toIntOrNull() ?: 0
+      val planarRgba = cached[4].toBooleanStrictOrNull()
+      if (threadCount > 0 && tileSize > 0 && planarRgba != null) {
+        nativeSetThreadingConfiguration(nativeHandle, threadCount, tileSize, planarRgba)
+        return
+      }
+    }
+
+    val configuration = nativeCalibrate(nativeHandle)
+    cacheFile?.let { file ->
+      runCatching {
+        file.writeText(
+          "${BuildConfig.VERSION_NAME},$cpuCount,${configuration[0]},${configuration[1]}," +
+            "${configuration[2] != 0}"
+        )
+      }
+    }
+  }
+
+  /**
+   * Adapt the number of threads and the blur precision to the thermal headroom of the device.
+   *
+   * Sustained blurs, e.g. of animated backgrounds, heat the device until it gets throttled,
+   * which hurts frame times more than a slower blur. When enabled, the Toolkit uses fewer
+   * threads as the device gets closer to being throttled.
+   *
+   * @return false if the device does not report its thermal headroom, i.e. before Android 12.
+   */
+  internal fun setThermalThrottling(enabled: Boolean): Boolean {
+    return nativeSetThermalThrottling(nativeHandle, enabled)
+  }
+
+  /**
+   * Returns the runtime metrics of the Toolkit as text, one line per metric: the calls,
+   * megapixels and p50/p99 latencies of each operation, how long calls waited for each other,
+   * how many rows each kernel path processed, and the buffers allocated.
+   *
+   * The kernel paths show how often the fast paths fall back to slower ones, e.g. for narrow
+   * images or on devices without SIMD.
+   */
+  internal fun dumpMetrics(): String = nativeDumpMetrics()
+
+  /**
+   * Resets the metrics returned by [dumpMetrics], except for the allocations.
+   */
+  internal fun resetMetrics() {
+    nativeResetMetrics()
+  }
+
+  /**
+   * Benchmarks blur over a grid of radii, sizes, and vector sizes, and returns the results as
+   * JSON, including the CPU model and the kernel path of each cell.
+   *
+   * This takes seconds. Save the results of two builds and compare them with
+   * scripts/compare-blur-benchmarks.py to find regressions.
+   *
+   * @param iterations The number of measured blurs per cell. At least 2.
+   * @param counters Whether to also read the hardware performance counters of each cell: the
+   * instructions per cycle, the bytes read per pixel, and the cache misses. They are null when
+   * the device doesn't provide them, see "adb shell setprop security.perf_harden 0".
+   */
+  internal fun benchmarkBlur(iterations: Int = 10, counters: Boolean = false): String {
+    require(iterations >= 2) {
+      "$externalName benchmarkBlur. The iterations should be at least 2. $iterations provided."
+    }
+    return nativeBenchmarkBlur(nativeHandle, iterations, counters)
+  }
+
   /**
    * Shutdown the thread pool.
    *
@@ -186,10 +750,78 @@ public object RenderScriptToolkit {
     nativeHandle = 0
   }
 
+  // The natives are registered by JNI_OnLoad. Their restrictions are passed as four ints, with
+  // a null Range2d as all zeros, so that no call has to read the fields of a Kotlin object.
   private external fun createNative(): Long
 
   private external fun destroyNative(nativeHandle: Long)
 
+  private external fun nativeCalibrate(nativeHandle: Long): IntArray
+
+  private external fun nativePrepareBlurWithinBudget(nativeHandle: Long)
+
+  private external fun nativeBlurBitmapWithinBudget(
+    nativeHandle: Long,
+    inputBitmap: Bitmap,
+    outputBitmap: Bitmap,
+    radius: Int,
+    budgetMicros: Long,
+    premultiplied: Boolean
+  ): Int
+
+  private external fun nativeDumpMetrics(): String
+
+  private external fun nativeResetMetrics()
+
+  private external fun nativeBenchmarkBlur(
+    nativeHandle: Long,
+    iterations: Int,
+    counters: Boolean
+  ): String
+
+  private external fun nativeSetThermalThrottling(nativeHandle: Long, enabled: Boolean): Boolean
+
+  private external fun nativeSetThreadingConfiguration(
+    nativeHandle: Long,
+    threadCount: Int,
+    tileSizeInBytes: Int,
+    planarRgba: Boolean
+  )
+
+  private external fun nativeCreateImage(inputBitmap: Bitmap, premultiplied: Boolean): Long
+
+  private external fun nativeDestroyImage(imageHandle: Long)
+
+  private external fun nativeCopyImageToBitmap(imageHandle: Long, outputBitmap: Bitmap)
+
+  private external fun nativeBlurImage(nativeHandle: Long, imageHandle: Long, radius: Int): Long
+
+  private external fun nativeBlurAndDownscaleImage(
+    nativeHandle: Long,
+    imageHandle: Long,
+    radius: Int,
+    outputWidth: Int,
+    outputHeight: Int
+  ): Long
+
+  private external fun nativeCreateSession(
+    nativeHandle: Long,
+    width: Int,
+    height: Int,
+    vectorSize: Int,
+    radius: Int,
+    premultiplied: Boolean,
+    tintColor: Int
+  ): Long
+
+  private external fun nativeDestroySession(sessionHandle: Long)
+
+  private external fun nativeSubmitSessionFrame(sessionHandle: Long, frame: Bitmap)
+
+  private external fun nativeAcquireSessionFrame(sessionHandle: Long, output: Bitmap): Long
+
+  private external fun nativeGetSessionDroppedFrameCount(sessionHandle: Long): Long
+
   private external fun nativeBlur(
     nativeHandle: Long,
     inputArray: ByteArray,
@@ -198,7 +830,63 @@ public object RenderScriptToolkit {
     sizeY: Int,
     radius: Int,
     outputArray: ByteArray,
-    restriction: Range2d?
+    restrictionStartX: Int,
+    restrictionEndX: Int,
+    restrictionStartY: Int,
+    restrictionEndY: Int
+  )
+
+  private external fun nativeBlurBitmapRegions(
+    nativeHandle: Long,
+    inputBitmap: Bitmap,
+    outputBitmap: Bitmap,
+    radius: Int,
+    regions: IntArray,
+    premultiplied: Boolean
+  )
+
+  private external fun nativeBlurBitmapScrolled(
+    nativeHandle: Long,
+    inputBitmap: Bitmap,
+    outputBitmap: Bitmap,
+    radius: Int,
+    dy: Int,
+    premultiplied: Boolean
+  )
+
+  private external fun nativeBlurBitmapClipped(
+    nativeHandle: Long,
+    inputBitmap: Bitmap,
+    outputBitmap: Bitmap,
+    radius: Int,
+    left: Float,
+    top: Float,
+    right: Float,
+    bottom: Float,
+    cornerRadius: Float,
+    clipMask: Bitmap?,
+    premultiplied: Boolean
+  )
+
+  private external fun nativeBlurAndDownscaleBitmap(
+    nativeHandle: Long,
+    inputBitmap: Bitmap,
+    outputBitmap: Bitmap,
+    radius: Int,
+    premultiplied: Boolean
+  )
+
+  private external fun nativeBlurPlanar(
+    nativeHandle: Long,
+    inputPlanes: Array<ByteArray>,
+    sizeX: Int,
+    sizeY: Int,
+    radius: Int,
+    outputPlanes: Array<ByteArray>,
+    restrictionStartX: Int,
+    restrictionEndX: Int,
+    restrictionStartY: Int,
+    restrictionEndY: Int
   )
 
   private external fun nativeBlurBitmap(
@@ -206,7 +894,11 @@ public object RenderScriptToolkit {
     inputBitmap: Bitmap,
     outputBitmap: Bitmap,
     radius: Int,
-    restriction: Range2d?
+    restrictionStartX: Int,
+    restrictionEndX: Int,
+    restrictionStartY: Int,
+    restrictionEndY: Int,
+    premultiplied: Boolean
   )
 }
 
@@ -230,6 +922,15 @@ public data class Range2d(
   internal constructor() : this(0, 0, 0, 0)
 }
 
+/**
+ * The result of [RenderScriptToolkit.blurWithinBudget].
+ *
+ * @property bitmap The blurred Bitmap, at the size of the input.
+ * @property downscaleFactor 1 if the Bitmap was blurred at full resolution, otherwise the factor
+ * it was downscaled by before being blurred and scaled back up, e.g. 2 for half the resolution.
+ */
+internal data class BudgetedBlur(val bitmap: Bitmap, val downscaleFactor: Int)
+
 internal class Rgba3dArray(val values: ByteArray, val sizeX: Int, val sizeY: Int, val sizeZ: Int) {
   init {
     require(values.size >= sizeX * sizeY * sizeZ * 4)
@@ -281,8 +982,22 @@ internal fun validateBitmap(
   }
 }
 
-internal fun createCompatibleBitmap(inputBitmap: Bitmap) =
-  Bitmap.createBitmap(inputBitmap.width, inputBitmap.height, inputBitmap.config)
+internal fun validateNativeImage(function: String, image: NativeImage) {
+  require(image.handle != 0L) {
+    "$externalName $function. The native image has been closed."
+  }
+}
+
+internal fun createCompatibleBitmap(
+  inputBitmap: Bitmap,
+  width: Int = inputBitmap.width,
+  height: Int = inputBitmap.height
+): Bitmap =
+  Bitmap.createBitmap(width, height, inputBitmap.config).apply {
+    if (inputBitmap.config == Bitmap.Config.ARGB_8888) {
+      isPremultiplied = inputBitmap.isPremultiplied
+    }
+  }
 
 internal fun validateRestriction(
   tag: String,
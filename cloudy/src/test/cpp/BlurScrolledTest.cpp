@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "RenderScriptToolkit.h"
+
+using renderscript::RenderScriptToolkit;
+
+namespace {
+
+// Written past the end of every output, to catch rows shifted with the wrong stride.
+constexpr uint8_t kCanary = 0xa5;
+constexpr size_t kCanarySize = 4096;
+
+/**
+ * Scrolls a random frame by dy and checks that blurScrolled, starting from the blur of the
+ * first frame, produces exactly the blur of the second one.
+ */
+bool checkScroll(RenderScriptToolkit* toolkit, size_t sizeX, size_t sizeY, size_t vectorSize,
+                 int radius, int dy) {
+    const size_t rowSize = sizeX * vectorSize;
+    const size_t size = rowSize * sizeY;
+    std::mt19937 random(static_cast<uint32_t>(sizeX * 31 + vectorSize * 7 + dy));
+    std::vector<uint8_t> first(size);
+    for (auto& value : first) {
+        value = static_cast<uint8_t>(random());
+    }
+
+    // Row y of the second frame shows row y + dy of the first; rows that scrolled in are new.
+    std::vector<uint8_t> second(size);
+    for (size_t y = 0; y < sizeY; y++) {
+        const long source = static_cast<long>(y) + dy;
+        uint8_t* row = second.data() + y * rowSize;
+        if (source >= 0 && source < static_cast<long>(sizeY)) {
+            memcpy(row, first.data() + source * rowSize, rowSize);
+        } else {
+            for (size_t i = 0; i < rowSize; i++) {
+                row[i] = static_cast<uint8_t>(random());
+            }
+        }
+    }
+
+    std::vector<uint8_t> expected(size);
+    toolkit->blur(second.data(), expected.data(), sizeX, sizeY, vectorSize, radius);
+
+    std::vector<uint8_t> out(size + kCanarySize, kCanary);
+    toolkit->blur(first.data(), out.data(), sizeX, sizeY, vectorSize, radius);
+    toolkit->blurScrolled(second.data(), out.data(), sizeX, sizeY, vectorSize, radius, dy);
+
+    for (size_t i = size; i < out.size(); i++) {
+        if (out[i] != kCanary) {
+            fprintf(stderr, "%zux%zu vectorSize %zu dy %d: wrote %zu bytes past the output\n",
+                    sizeX, sizeY, vectorSize, dy, i - size + 1);
+            return false;
+        }
+    }
+    for (size_t i = 0; i < size; i++) {
+        if (out[i] != expected[i]) {
+            fprintf(stderr, "%zux%zu vectorSize %zu dy %d: byte %zu (row %zu) is %u, expected %u\n",
+                    sizeX, sizeY, vectorSize, dy, i, i / rowSize, out[i], expected[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    RenderScriptToolkit toolkit;
+    bool passed = true;
+    for (size_t vectorSize : {1, 3, 4}) {
+        for (int dy : {1, 9, -1, -9, 40, -40}) {
+            // An odd width so that a stride of the padded cell size lands on the wrong bytes.
+            passed &= checkScroll(&toolkit, 37, 64, vectorSize, 5, dy);
+            passed &= checkScroll(&toolkit, 200, 150, vectorSize, 25, dy);
+        }
+    }
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
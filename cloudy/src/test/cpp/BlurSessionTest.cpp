@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "BlurSession.h"
+#include "Metrics.h"
+#include "RenderScriptToolkit.h"
+
+using renderscript::BlurSession;
+using renderscript::kKernelPathCount;
+using renderscript::KernelPath;
+using renderscript::MetricsRegistry;
+using renderscript::RenderScriptToolkit;
+
+namespace {
+
+constexpr size_t kSizeX = 211;
+constexpr size_t kSizeY = 137;
+constexpr size_t kVectorSize = 4;
+constexpr int kRadius = 12;
+
+// Waits up to 5 seconds for condition to hold, which is plenty for blurs this small.
+bool waitFor(const std::function<bool()>& condition) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// The rows blurred so far by all the kernel paths.
+uint64_t blurredRows() {
+    uint64_t rows = 0;
+    for (size_t p = 0; p < kKernelPathCount; p++) {
+        rows += MetricsRegistry::get().getKernelRows(static_cast<KernelPath>(p));
+    }
+    return rows;
+}
+
+// The post-process of the session, which the expected frames get too.
+void invert(uint8_t* frame) {
+    for (size_t i = 0; i < kSizeX * kSizeY * kVectorSize; i++) {
+        frame[i] = static_cast<uint8_t>(255 - frame[i]);
+    }
+}
+
+}  // namespace
+
+/**
+ * Checks that the next frame is blurred while the previous one is post-processed, and that the
+ * published frames are those of the blur followed by the post-process.
+ */
+int main() {
+    RenderScriptToolkit toolkit;
+    std::mt19937 random(98);
+    std::vector<uint8_t> frames[2];
+    for (auto& frame : frames) {
+        frame.resize(kSizeX * kSizeY * kVectorSize);
+        for (auto& value : frame) {
+            value = static_cast<uint8_t>(random());
+        }
+    }
+    std::vector<uint8_t> expected(frames[1].size());
+    toolkit.blur(frames[1].data(), expected.data(), kSizeX, kSizeY, kVectorSize, kRadius, nullptr);
+    invert(expected.data());
+
+    // The post-process of the first frame holds on until it's released.
+    std::atomic<int> postProcessed{0};
+    std::atomic<bool> firstStarted{false};
+    std::atomic<bool> released{false};
+    bool passed = true;
+    {
+        BlurSession session(&toolkit, kSizeX, kSizeY, kVectorSize, kRadius,
+                            renderscript::AlphaMode::Premultiplied, [&](uint8_t* frame) {
+                                if (postProcessed == 0) {
+                                    firstStarted = true;
+                                    waitFor([&] { return released.load(); });
+                                }
+                                invert(frame);
+                                postProcessed++;
+                            });
+
+        session.submitFrame(frames[0].data());
+        if (!waitFor([&] { return firstStarted.load(); })) {
+            fprintf(stderr, "The first frame was never post-processed\n");
+            passed = false;
+        }
+        const uint64_t rowsBefore = blurredRows();
+        session.submitFrame(frames[1].data());
+        if (!waitFor([&] { return blurredRows() > rowsBefore; })) {
+            fprintf(stderr, "The second frame wasn't blurred while the first was post-processed\n");
+            passed = false;
+        }
+        if (session.acquireLatestFrame() != nullptr) {
+            fprintf(stderr, "A frame was published before its post-process finished\n");
+            passed = false;
+        }
+        released = true;
+
+        uint64_t frameNumber = 0;
+        const uint8_t* latest = nullptr;
+        waitFor([&] {
+            latest = session.acquireLatestFrame(&frameNumber);
+            return frameNumber == 2;
+        });
+        if (frameNumber != 2 || latest == nullptr) {
+            fprintf(stderr, "The second frame was never published, got %llu\n",
+                    static_cast<unsigned long long>(frameNumber));
+            passed = false;
+        } else if (memcmp(latest, expected.data(), expected.size()) != 0) {
+            fprintf(stderr, "The second frame differs from its blur and post-process\n");
+            passed = false;
+        }
+        if (session.getDroppedFrameCount() != 0) {
+            fprintf(stderr, "%llu frames were dropped\n",
+                    static_cast<unsigned long long>(session.getDroppedFrameCount()));
+            passed = false;
+        }
+    }
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
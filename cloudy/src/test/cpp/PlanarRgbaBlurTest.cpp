@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "RenderScriptToolkit.h"
+
+using renderscript::Restriction;
+using renderscript::RenderScriptToolkit;
+using renderscript::ThreadingConfiguration;
+
+namespace {
+
+// The tilings to compare, from tiles of many rows to tiles of a single row.
+constexpr ThreadingConfiguration kConfigurations[] = {
+        {1, 64 * 1024}, {3, 1000}, {4, 4 * 1024}, {2, 100},
+};
+
+std::vector<uint8_t> randomImage(size_t sizeX, size_t sizeY, std::mt19937* random) {
+    std::vector<uint8_t> image(sizeX * sizeY * 4);
+    for (size_t i = 0; i < image.size(); i += 4) {
+        // Valid premultiplied data: no channel above the alpha.
+        image[i + 3] = static_cast<uint8_t>((*random)());
+        for (size_t c = 0; c < 3; c++) {
+            image[i + c] = static_cast<uint8_t>((*random)() % (image[i + 3] + 1u));
+        }
+    }
+    return image;
+}
+
+/**
+ * Checks that the RGBA blur through the single channel kernels is within 1 of the interleaved
+ * one, and that it gives the same result with each tiling, i.e. that the deinterleaved rows of
+ * each tile include its whole halo.
+ */
+bool checkPlanar(RenderScriptToolkit* toolkit, size_t sizeX, size_t sizeY, int radius,
+                 const Restriction* restriction) {
+    std::mt19937 random(static_cast<uint32_t>(sizeX * 31 + radius));
+    const std::vector<uint8_t> in = randomImage(sizeX, sizeY, &random);
+    std::vector<uint8_t> interleaved(in.size(), 0);
+    toolkit->setThreadingConfiguration(kConfigurations[0]);
+    toolkit->blur(in.data(), interleaved.data(), sizeX, sizeY, 4, radius, restriction);
+
+    std::vector<uint8_t> expected(in.size(), 0);
+    std::vector<uint8_t> out(in.size(), 0);
+    bool passed = true;
+    for (size_t i = 0; i < sizeof(kConfigurations) / sizeof(kConfigurations[0]); i++) {
+        ThreadingConfiguration configuration = kConfigurations[i];
+        configuration.planarRgba = true;
+        toolkit->setThreadingConfiguration(configuration);
+        std::vector<uint8_t>& result = i == 0 ? expected : out;
+        toolkit->blur(in.data(), result.data(), sizeX, sizeY, 4, radius, restriction);
+        for (size_t b = 0; b < in.size(); b++) {
+            const std::vector<uint8_t>& reference = i == 0 ? interleaved : expected;
+            const int difference = abs(result[b] - reference[b]);
+            if (difference > (i == 0 ? 1 : 0)) {
+                fprintf(stderr,
+                        "%zux%zu radius %d: byte %zu (cell %zu,%zu) is %u with %d threads and "
+                        "%d byte tiles, %u %s\n",
+                        sizeX, sizeY, radius, b, b / 4 % sizeX, b / (sizeX * 4), result[b],
+                        configuration.threadCount, configuration.tileSizeInBytes, reference[b],
+                        i == 0 ? "interleaved" : "otherwise");
+                passed = false;
+                break;
+            }
+        }
+    }
+    return passed;
+}
+
+}  // namespace
+
+int main() {
+    RenderScriptToolkit toolkit;
+    bool passed = true;
+    for (int radius : {1, 8, 25}) {
+        // An odd width, whose planes are padded, and one of whole vectors.
+        for (size_t sizeX : {301, 640}) {
+            passed &= checkPlanar(&toolkit, sizeX, 157, radius, nullptr);
+            const Restriction area{sizeX / 4, sizeX / 2, 40, 90};
+            passed &= checkPlanar(&toolkit, sizeX, 157, radius, &area);
+        }
+    }
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
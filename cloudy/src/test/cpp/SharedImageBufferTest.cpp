@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "RenderScriptToolkit.h"
+
+using renderscript::createSharedImageBuffer;
+using renderscript::mapSharedImageBuffer;
+using renderscript::RenderScriptToolkit;
+using renderscript::SharedImageBuffer;
+
+namespace {
+
+constexpr size_t kSizeX = 97;
+constexpr size_t kSizeY = 61;
+constexpr size_t kVectorSize = 4;
+constexpr size_t kSize = kSizeX * kSizeY * kVectorSize;
+constexpr int kRadius = 9;
+
+// Sends fd over a Unix socket, as a producer would send it to a sandboxed process.
+bool sendFd(int socket, int fd) {
+    char byte = 0;
+    iovec data{&byte, 1};
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &fd, sizeof(int));
+    return sendmsg(socket, &message, 0) == 1;
+}
+
+// Receives a file descriptor sent by sendFd(). Returns -1 on failure.
+int receiveFd(int socket) {
+    char byte;
+    iovec data{&byte, 1};
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (recvmsg(socket, &message, 0) != 1) {
+        return -1;
+    }
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (header == nullptr || header->cmsg_type != SCM_RIGHTS) {
+        return -1;
+    }
+    int fd;
+    memcpy(&fd, CMSG_DATA(header), sizeof(int));
+    return fd;
+}
+
+// The other process: maps the two buffers it receives and blurs the first into the second.
+int runWorker(int socket) {
+    std::unique_ptr<SharedImageBuffer> in = mapSharedImageBuffer(receiveFd(socket), kSize);
+    std::unique_ptr<SharedImageBuffer> out = mapSharedImageBuffer(receiveFd(socket), kSize);
+    if (in == nullptr || out == nullptr) {
+        return 2;
+    }
+    // The Toolkit is created after the fork, as its pool threads would not survive one.
+    RenderScriptToolkit toolkit;
+    toolkit.blur(in->data(), out->data(), kSizeX, kSizeY, kVectorSize, kRadius);
+    const char done = 1;
+    return write(socket, &done, 1) == 1 ? 0 : 3;
+}
+
+/**
+ * Hands a frame to another process through shared buffers and checks that the blur it writes
+ * in place is the one this process computes.
+ */
+bool checkTwoProcessBlur() {
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        perror("socketpair");
+        return false;
+    }
+    const pid_t worker = fork();
+    if (worker == 0) {
+        close(sockets[0]);
+        _exit(runWorker(sockets[1]));
+    }
+    close(sockets[1]);
+
+    std::unique_ptr<SharedImageBuffer> in = createSharedImageBuffer(kSize, "test-in");
+    std::unique_ptr<SharedImageBuffer> out = createSharedImageBuffer(kSize, "test-out");
+    if (in == nullptr || out == nullptr) {
+        fprintf(stderr, "Could not create the shared buffers\n");
+        return false;
+    }
+    for (size_t i = 0; i < kSize; i++) {
+        in->data()[i] = static_cast<uint8_t>(i * 7 + (i / (kSizeX * kVectorSize)) * 13);
+    }
+    char done = 0;
+    const bool sent = sendFd(sockets[0], in->fd()) && sendFd(sockets[0], out->fd());
+    const bool finished = sent && read(sockets[0], &done, 1) == 1 && done == 1;
+    int status = 0;
+    waitpid(worker, &status, 0);
+    close(sockets[0]);
+    if (!finished || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "The worker failed with status %d\n", status);
+        return false;
+    }
+
+    std::vector<uint8_t> expected(kSize);
+    RenderScriptToolkit toolkit;
+    toolkit.blur(in->data(), expected.data(), kSizeX, kSizeY, kVectorSize, kRadius);
+    if (memcmp(out->data(), expected.data(), kSize) != 0) {
+        fprintf(stderr, "The blur of the worker differs from the local one\n");
+        return false;
+    }
+    return true;
+}
+
+// Checks the buffers a receiver must refuse, as their sender could shrink them under it.
+bool checkRejections() {
+    bool passed = true;
+
+    // Not sealed at all.
+    const int unsealed = static_cast<int>(syscall(__NR_memfd_create, "test-unsealed", 0));
+    if (unsealed < 0 || ftruncate(unsealed, kSize) != 0) {
+        perror("memfd_create");
+        return false;
+    }
+    if (mapSharedImageBuffer(unsealed, kSize) != nullptr) {
+        fprintf(stderr, "An unsealed buffer was accepted\n");
+        passed = false;
+    }
+
+    std::unique_ptr<SharedImageBuffer> buffer = createSharedImageBuffer(kSize);
+    if (buffer == nullptr) {
+        fprintf(stderr, "Could not create a shared buffer\n");
+        return false;
+    }
+    // Smaller than what the receiver expects.
+    if (mapSharedImageBuffer(dup(buffer->fd()), kSize + 1) != nullptr) {
+        fprintf(stderr, "A buffer smaller than expected was accepted\n");
+        passed = false;
+    }
+    if (mapSharedImageBuffer(dup(buffer->fd()), 0) != nullptr) {
+        fprintf(stderr, "An empty mapping was accepted\n");
+        passed = false;
+    }
+    // The seal holds: the sender can't shrink the buffer anymore.
+    if (ftruncate(buffer->fd(), kSize / 2) == 0) {
+        fprintf(stderr, "A sealed buffer was shrunk\n");
+        passed = false;
+    }
+    if (createSharedImageBuffer(0) != nullptr) {
+        fprintf(stderr, "An empty buffer was created\n");
+        passed = false;
+    }
+    return passed;
+}
+
+}  // namespace
+
+int main() {
+    bool passed = checkTwoProcessBlur();
+    passed &= checkRejections();
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "Metrics.h"
+#include "RenderScriptToolkit.h"
+
+using renderscript::AlphaMode;
+using renderscript::BlurSpace;
+using renderscript::KernelPath;
+using renderscript::MetricsRegistry;
+using renderscript::RenderScriptToolkit;
+using renderscript::ThreadingConfiguration;
+
+namespace {
+
+// The tilings to compare, from tiles of many rows to tiles of a few. The smaller the tiles, the
+// more of them have a neighborhood of a single color.
+constexpr ThreadingConfiguration kConfigurations[] = {
+        {1, 64 * 1024}, {1, 1000}, {3, 1000}, {4, 4 * 1024}, {2, 16 * 1024},
+};
+
+/**
+ * Blurs a flat image with a noisy patch with each tiling, and checks that the results are the
+ * same, i.e. that the tiles copied because their neighborhood is a single color get exactly what
+ * the kernels would have computed.
+ */
+bool checkTilings(RenderScriptToolkit* toolkit, size_t sizeX, size_t sizeY, size_t vectorSize,
+                  int radius, AlphaMode alphaMode, BlurSpace blurSpace) {
+    const size_t size = sizeX * sizeY * vectorSize;
+    std::vector<uint8_t> in(size);
+    // A color that the truncating kernels may not return exactly, and that is valid
+    // premultiplied data.
+    const uint8_t color[4] = {201, 77, 133, 233};
+    std::mt19937 random(static_cast<uint32_t>(sizeX + vectorSize));
+    for (size_t y = 0; y < sizeY; y++) {
+        for (size_t x = 0; x < sizeX; x++) {
+            const bool patch = x > sizeX / 3 && x < sizeX / 2 && y > sizeY / 3 && y < sizeY / 2;
+            uint8_t* cell = in.data() + (y * sizeX + x) * vectorSize;
+            for (size_t c = 0; c < vectorSize; c++) {
+                cell[c] = patch ? static_cast<uint8_t>(random()) : color[c];
+            }
+            if (patch && vectorSize == 4 && alphaMode == AlphaMode::Premultiplied) {
+                // Opaque, so that the random colors are valid premultiplied data.
+                cell[3] = 255;
+            }
+        }
+    }
+
+    std::vector<uint8_t> expected(size);
+    std::vector<uint8_t> out(size);
+    bool passed = true;
+    bool copiedRows = false;
+    for (size_t i = 0; i < sizeof(kConfigurations) / sizeof(kConfigurations[0]); i++) {
+        toolkit->setThreadingConfiguration(kConfigurations[i]);
+        const uint64_t uniformRows = MetricsRegistry::get().getKernelRows(KernelPath::Uniform);
+        toolkit->blur(in.data(), i == 0 ? expected.data() : out.data(), sizeX, sizeY, vectorSize,
+                      radius, nullptr, alphaMode, blurSpace);
+        copiedRows |= MetricsRegistry::get().getKernelRows(KernelPath::Uniform) > uniformRows;
+        if (i == 0) {
+            continue;
+        }
+        for (size_t b = 0; b < size; b++) {
+            if (out[b] != expected[b]) {
+                fprintf(stderr,
+                        "%zux%zu vectorSize %zu radius %d: byte %zu (row %zu) is %u with %d "
+                        "threads and %d byte tiles, %u otherwise\n",
+                        sizeX, sizeY, vectorSize, radius, b, b / (sizeX * vectorSize), out[b],
+                        kConfigurations[i].threadCount, kConfigurations[i].tileSizeInBytes,
+                        expected[b]);
+                passed = false;
+                break;
+            }
+        }
+    }
+    if (!copiedRows) {
+        fprintf(stderr, "%zux%zu vectorSize %zu radius %d: no uniform tile was copied\n", sizeX,
+                sizeY, vectorSize, radius);
+        passed = false;
+    }
+    return passed;
+}
+
+}  // namespace
+
+int main() {
+    RenderScriptToolkit toolkit;
+    bool passed = true;
+    for (int radius : {1, 8, 25}) {
+        // An odd width, whose rows have different alignments, and one made of whole tiles.
+        for (size_t sizeX : {301, 640}) {
+            passed &= checkTilings(&toolkit, sizeX, 257, 1, radius, AlphaMode::Premultiplied,
+                                   BlurSpace::Encoded);
+            passed &= checkTilings(&toolkit, sizeX, 257, 3, radius, AlphaMode::Premultiplied,
+                                   BlurSpace::Encoded);
+            passed &= checkTilings(&toolkit, sizeX, 257, 4, radius, AlphaMode::Premultiplied,
+                                   BlurSpace::Encoded);
+            passed &= checkTilings(&toolkit, sizeX, 257, 4, radius, AlphaMode::Unpremultiplied,
+                                   BlurSpace::Encoded);
+            passed &= checkTilings(&toolkit, sizeX, 257, 4, radius, AlphaMode::Premultiplied,
+                                   BlurSpace::Linear);
+        }
+    }
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
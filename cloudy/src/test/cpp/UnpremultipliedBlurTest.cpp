@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "RenderScriptToolkit.h"
+
+using renderscript::AlphaMode;
+using renderscript::Restriction;
+using renderscript::RenderScriptToolkit;
+
+namespace {
+
+constexpr size_t kSizeX = 123;
+constexpr size_t kSizeY = 97;
+
+std::vector<uint8_t> randomImage(std::mt19937* random) {
+    std::vector<uint8_t> image(kSizeX * kSizeY * 4);
+    for (auto& value : image) {
+        value = static_cast<uint8_t>((*random)());
+    }
+    return image;
+}
+
+/**
+ * Checks that an unpremultiplied blur restricted to an area matches the same area of the full
+ * blur, i.e. that the rows of its halo are premultiplied too.
+ */
+bool checkRestricted(RenderScriptToolkit* toolkit, const std::vector<uint8_t>& in, int radius,
+                     const Restriction& area) {
+    std::vector<uint8_t> full(in.size());
+    toolkit->blur(in.data(), full.data(), kSizeX, kSizeY, 4, radius, nullptr,
+                  AlphaMode::Unpremultiplied);
+    std::vector<uint8_t> restricted(in.size(), 0);
+    toolkit->blur(in.data(), restricted.data(), kSizeX, kSizeY, 4, radius, &area,
+                  AlphaMode::Unpremultiplied);
+    for (size_t y = area.startY; y < area.endY; y++) {
+        for (size_t x = area.startX; x < area.endX; x++) {
+            for (size_t c = 0; c < 4; c++) {
+                const size_t i = (y * kSizeX + x) * 4 + c;
+                if (restricted[i] != full[i]) {
+                    fprintf(stderr, "radius %d: cell %zu,%zu channel %zu is %u, expected %u\n",
+                            radius, x, y, c, restricted[i], full[i]);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// The operations that are checked for bleeding.
+enum class Operation { Blur, BlurAndDownscale, BlurWithinBudget };
+
+/**
+ * Checks that transparent cells don't bleed: an opaque red area next to transparent green
+ * cells stays pure red wherever it's not fully transparent.
+ */
+bool checkNoBleeding(RenderScriptToolkit* toolkit, int radius, Operation operation) {
+    std::vector<uint8_t> in(kSizeX * kSizeY * 4);
+    for (size_t i = 0; i < kSizeX * kSizeY; i++) {
+        const bool red = (i % kSizeX) < kSizeX / 2;
+        in[i * 4 + 0] = red ? 255 : 0;
+        in[i * 4 + 1] = red ? 0 : 255;
+        in[i * 4 + 2] = 0;
+        in[i * 4 + 3] = red ? 255 : 0;
+    }
+    // A third of the size. At radius 1, blurAndDownscale() only averages.
+    const bool downscale = operation == Operation::BlurAndDownscale;
+    const size_t outputSizeX = downscale ? kSizeX / 3 : kSizeX;
+    const size_t outputSizeY = downscale ? kSizeY / 3 : kSizeY;
+    std::vector<uint8_t> out(outputSizeX * outputSizeY * 4);
+    switch (operation) {
+        case Operation::Blur:
+            toolkit->blur(in.data(), out.data(), kSizeX, kSizeY, 4, radius, nullptr,
+                          AlphaMode::Unpremultiplied);
+            break;
+        case Operation::BlurAndDownscale:
+            toolkit->blurAndDownscale(in.data(), out.data(), kSizeX, kSizeY, 4, outputSizeX,
+                                      outputSizeY, radius, AlphaMode::Unpremultiplied);
+            break;
+        case Operation::BlurWithinBudget:
+            // A budget no strategy fits, so that the image is downscaled and upscaled back.
+            toolkit->blurWithinBudget(in.data(), out.data(), kSizeX, kSizeY, 4, radius, 1,
+                                      AlphaMode::Unpremultiplied);
+            break;
+    }
+    for (size_t i = 0; i < outputSizeX * outputSizeY; i++) {
+        const uint8_t* cell = out.data() + i * 4;
+        if (cell[3] != 0 && (cell[0] != 255 || cell[1] != 0 || cell[2] != 0)) {
+            fprintf(stderr, "operation %d radius %d: cell %zu is %u,%u,%u,%u, expected pure red\n",
+                    static_cast<int>(operation), radius, i, cell[0], cell[1], cell[2], cell[3]);
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    RenderScriptToolkit toolkit;
+    std::mt19937 random(78);
+    const std::vector<uint8_t> in = randomImage(&random);
+    bool passed = true;
+    for (int radius : {1, 7, 25}) {
+        passed &= checkRestricted(&toolkit, in, radius, Restriction{10, 60, 30, 50});
+        passed &= checkRestricted(&toolkit, in, radius, Restriction{0, kSizeX, 0, 5});
+        passed &= checkRestricted(&toolkit, in, radius, Restriction{40, 41, kSizeY - 3, kSizeY});
+        passed &= checkNoBleeding(&toolkit, radius, Operation::Blur);
+        passed &= checkNoBleeding(&toolkit, radius, Operation::BlurAndDownscale);
+        passed &= checkNoBleeding(&toolkit, radius, Operation::BlurWithinBudget);
+    }
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
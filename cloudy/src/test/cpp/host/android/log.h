@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RENDERSCRIPT_TOOLKIT_HOST_LOG_H
+#define ANDROID_RENDERSCRIPT_TOOLKIT_HOST_LOG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// Host stand-in for the NDK's logging: messages go to stderr.
+
+enum android_LogPriority {
+    ANDROID_LOG_VERBOSE = 2,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+};
+
+inline int __android_log_print(int priority, const char* tag, const char* format, ...) {
+    static const char kLevels[] = "VDIWE";
+    const char level = priority >= ANDROID_LOG_VERBOSE && priority <= ANDROID_LOG_ERROR
+                               ? kLevels[priority - ANDROID_LOG_VERBOSE]
+                               : '?';
+    fprintf(stderr, "%c/%s: ", level, tag);
+    va_list args;
+    va_start(args, format);
+    const int written = vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    return written;
+}
+
+#endif  // ANDROID_RENDERSCRIPT_TOOLKIT_HOST_LOG_H
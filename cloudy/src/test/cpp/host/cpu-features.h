@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RENDERSCRIPT_TOOLKIT_HOST_CPU_FEATURES_H
+#define ANDROID_RENDERSCRIPT_TOOLKIT_HOST_CPU_FEATURES_H
+
+#include <stdint.h>
+
+// Host stand-in for the NDK's cpufeatures. It reports an unknown CPU, which makes the toolkit
+// use its portable kernels.
+
+typedef enum {
+    ANDROID_CPU_FAMILY_UNKNOWN = 0,
+    ANDROID_CPU_FAMILY_ARM,
+    ANDROID_CPU_FAMILY_X86,
+    ANDROID_CPU_FAMILY_MIPS,
+    ANDROID_CPU_FAMILY_ARM64,
+    ANDROID_CPU_FAMILY_X86_64,
+    ANDROID_CPU_FAMILY_MIPS64,
+} AndroidCpuFamily;
+
+enum {
+    ANDROID_CPU_ARM_FEATURE_NEON = (1 << 2),
+    ANDROID_CPU_X86_FEATURE_SSSE3 = (1 << 0),
+    ANDROID_CPU_ARM64_FEATURE_ASIMD = (1 << 1),
+};
+
+inline AndroidCpuFamily android_getCpuFamily() { return ANDROID_CPU_FAMILY_UNKNOWN; }
+
+inline uint64_t android_getCpuFeatures() { return 0; }
+
+#endif  // ANDROID_RENDERSCRIPT_TOOLKIT_HOST_CPU_FEATURES_H
@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+#
+# Designed and developed by 2022 skydoves (Jaewoong Eum)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Compares two results of RenderScriptToolkit.benchmarkBlur().
+
+Each (radius, size, vectorSize, mode) cell is compared with Welch's t-test on the throughput of
+its iterations. A cell regressed if its mean throughput dropped by more than --threshold and the
+drop is significant at --alpha. Exits with 1 if any cell regressed.
+
+The cost of the unpremultiplied, linear, and planar RGBA modes relative to the premultiplied blur
+of the candidate is printed too, and so are the instructions per cycle and the bytes read per
+pixel of both results when they were benchmarked with counters.
+
+  python3 scripts/compare-blur-benchmarks.py baseline.json candidate.json
+"""
+
+import argparse
+import json
+import math
+import sys
+
+SCHEMA_VERSION = 1
+
+
+def incomplete_beta(a, b, x):
+    """The regularized incomplete beta function, by its continued fraction."""
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    if x > (a + 1.0) / (a + b + 2.0):
+        return 1.0 - incomplete_beta(b, a, 1.0 - x)
+    front = math.exp(
+        math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b)
+        + a * math.log(x) + b * math.log(1.0 - x)) / a
+    tiny = 1e-30
+    c, d = 1.0, 1.0 - (a + b) * x / (a + 1.0)
+    d = 1.0 / (d if abs(d) > tiny else tiny)
+    f = d
+    for m in range(1, 200):
+        for numerator in (
+                m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m)),
+                -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1))):
+            d = 1.0 + numerator * d
+            d = 1.0 / (d if abs(d) > tiny else tiny)
+            c = 1.0 + numerator / c
+            c = c if abs(c) > tiny else tiny
+            f *= c * d
+        if abs(c * d - 1.0) < 1e-12:
+            break
+    return front * f
+
+
+def welch_p_value(baseline, candidate):
+    """The two-sided p-value of Welch's t-test."""
+    n1, n2 = len(baseline), len(candidate)
+    mean1, mean2 = sum(baseline) / n1, sum(candidate) / n2
+    var1 = sum((s - mean1) ** 2 for s in baseline) / (n1 - 1)
+    var2 = sum((s - mean2) ** 2 for s in candidate) / (n2 - 1)
+    se1, se2 = var1 / n1, var2 / n2
+    if se1 + se2 == 0.0:
+        return 0.0 if mean1 != mean2 else 1.0
+    t = (mean1 - mean2) / math.sqrt(se1 + se2)
+    df = (se1 + se2) ** 2 / (se1 ** 2 / (n1 - 1) + se2 ** 2 / (n2 - 1))
+    return incomplete_beta(df / 2.0, 0.5, df / (df + t * t))
+
+
+def load(path):
+    with open(path) as file:
+        results = json.load(file)
+    if results.get("schemaVersion") != SCHEMA_VERSION:
+        sys.exit("%s: unsupported schemaVersion %s" % (path, results.get("schemaVersion")))
+    cells = {}
+    for cell in results["results"]:
+        key = (cell["radius"], cell["sizeX"], cell["sizeY"], cell["vectorSize"],
+               cell.get("mode", "premultiplied"))
+        cells[key] = cell
+    return results, cells
+
+
+def format_counter(value):
+    """A counter of benchmarkBlur(counters=true), which is null when it's not available."""
+    return "n/a" if value is None else "%.2f" % value
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("--alpha", type=float, default=0.01,
+                        help="the significance level of a change (default: 0.01)")
+    parser.add_argument("--threshold", type=float, default=0.03,
+                        help="the smallest relative change that's reported (default: 0.03)")
+    args = parser.parse_args()
+
+    baseline, baseline_cells = load(args.baseline)
+    candidate, candidate_cells = load(args.candidate)
+    for field in ("cpu", "threads", "tileSizeInBytes", "planarRgba"):
+        # Older results have no planarRgba, which was always off then.
+        old_value = baseline.get(field, False)
+        new_value = candidate.get(field, False)
+        if old_value != new_value:
+            print("warning: %s differs: %s vs %s" % (field, old_value, new_value))
+
+    print("%-6s %-10s %-6s %-15s %10s %10s %8s %8s  %s" % (
+        "radius", "size", "vector", "mode", "baseline", "candidate", "change", "p", "verdict"))
+    regressions = 0
+    for key in sorted(baseline_cells):
+        if key not in candidate_cells:
+            print("warning: cell %s is missing from the candidate" % (key,))
+            continue
+        old, new = baseline_cells[key], candidate_cells[key]
+        old_mean = old["mpixPerSecond"]["mean"]
+        new_mean = new["mpixPerSecond"]["mean"]
+        change = (new_mean - old_mean) / old_mean
+        p = welch_p_value(old["samples"], new["samples"])
+        verdict = ""
+        if p < args.alpha and abs(change) >= args.threshold:
+            verdict = "REGRESSION" if change < 0 else "improvement"
+            regressions += change < 0
+        if old["kernelPath"] != new["kernelPath"]:
+            verdict += " (path %s -> %s)" % (old["kernelPath"], new["kernelPath"])
+        radius, size_x, size_y, vector_size, mode = key
+        print("%-6d %-10s %-6d %-15s %10.1f %10.1f %+7.1f%% %8.4f  %s" % (
+            radius, "%dx%d" % (size_x, size_y), vector_size, mode, old_mean, new_mean,
+            change * 100, p, verdict))
+
+    print("%d regression(s)" % regressions)
+
+    print()
+    print("%-6s %-10s %-15s %10s" % ("radius", "size", "mode", "extra time"))
+    for key in sorted(candidate_cells):
+        radius, size_x, size_y, vector_size, mode = key
+        reference = candidate_cells.get((radius, size_x, size_y, vector_size, "premultiplied"))
+        if vector_size != 4 or mode == "premultiplied" or reference is None:
+            continue
+        # Throughput is inversely proportional to the time per pixel.
+        extra = (reference["mpixPerSecond"]["mean"] /
+                 candidate_cells[key]["mpixPerSecond"]["mean"] - 1.0)
+        print("%-6d %-10s %-15s %+9.1f%%" % (
+            radius, "%dx%d" % (size_x, size_y), mode, extra * 100))
+
+    counted = [key for key in sorted(candidate_cells)
+               if key in baseline_cells and "counters" in candidate_cells[key]
+               and "counters" in baseline_cells[key]]
+    if counted:
+        print()
+        print("%-6s %-10s %-6s %-15s %15s %21s" % (
+            "radius", "size", "vector", "mode", "IPC", "bytes/pixel"))
+        for key in counted:
+            radius, size_x, size_y, vector_size, mode = key
+            old = baseline_cells[key]["counters"]
+            new = candidate_cells[key]["counters"]
+            print("%-6d %-10s %-6d %-15s %15s %21s" % (
+                radius, "%dx%d" % (size_x, size_y), vector_size, mode,
+                "%s -> %s" % (format_counter(old["instructionsPerCycle"]),
+                              format_counter(new["instructionsPerCycle"])),
+                "%s -> %s" % (format_counter(old["bytesPerPixel"]),
+                              format_counter(new["bytesPerPixel"]))))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())